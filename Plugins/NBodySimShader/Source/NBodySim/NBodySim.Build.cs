@@ -14,6 +14,11 @@ namespace UnrealBuildTool.Rules
 				"NBodySim/Private"
 			});
 
+			PublicDependencyModuleNames.AddRange(new string[]
+			{
+				"NBodySimCore"
+			});
+
 			PrivateDependencyModuleNames.AddRange(new string[]
 			{
 				"Core",
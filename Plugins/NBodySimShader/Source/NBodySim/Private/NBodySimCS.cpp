@@ -12,6 +12,7 @@
 #include "StaticMeshResources.h"
 #include "UnifiedBuffer.h"
 #include "NBodySimModule.h"
+#include "NBodySimEnsemble.h"
 
 DECLARE_STATS_GROUP(TEXT("NBodySimCS"), STATGROUP_NBodySimCS, STATCAT_Advanced);
 DECLARE_CYCLE_STAT(TEXT("NBodySimCS Execute"), STAT_NBodySimCS_Execute, STATGROUP_NBodySimCS);
@@ -62,61 +63,133 @@ public:
 IMPLEMENT_GLOBAL_SHADER(FNBodySimCS, "/NBodySimShaders/Private/NBodySim.usf", "CalculateVelocitiesCS", SF_Compute);
 
 
+/**
+ *	Velocity pass of the ensemble step, same kernel as FNBodySimCS but reading its settings per body
+ *	from the packed systems of an ensemble.
+ */
+class FNBodySimEnsembleCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FNBodySimEnsembleCS);
+	SHADER_USE_PARAMETER_STRUCT(FNBodySimEnsembleCS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_SRV(StructuredBuffer<float>, Masses)
+		SHADER_PARAMETER_UAV(RWStructuredBuffer<FVector2f>, Positions)
+		SHADER_PARAMETER_UAV(RWStructuredBuffer<FVector2f>, Velocities)
+		SHADER_PARAMETER_SRV(StructuredBuffer<FNBodySimSystemConstants>, Systems)
+		SHADER_PARAMETER_SRV(StructuredBuffer<uint>, BodySystemIndices)
+		SHADER_PARAMETER(uint32, TotalNumBodies)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return true;
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FNBodySimEnsembleCS, "/NBodySimShaders/Private/NBodySim.usf", "CalculateEnsembleVelocitiesCS", SF_Compute);
 
-void FNBodySimCSBuffers::Initialize(const FNBodySimParameters& SimParameters)
+/**
+ *	Position pass of the ensemble step, run once every velocity of FNBodySimEnsembleCS is written.
+ */
+class FNBodySimEnsemblePositionsCS : public FGlobalShader
 {
-	if (!MassesBuffer || !MassesBufferSRV)
+public:
+	DECLARE_GLOBAL_SHADER(FNBodySimEnsemblePositionsCS);
+	SHADER_USE_PARAMETER_STRUCT(FNBodySimEnsemblePositionsCS, FGlobalShader);
+
+	using FParameters = FNBodySimEnsembleCS::FParameters;
+
+public:
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
-		TResourceArray<float> ResourceArray;
-		ResourceArray.Init(0.0f, SimParameters.Bodies.Num());
+		return true;
+	}
+};
 
-		for (int i = 0; i < SimParameters.Bodies.Num(); i++)
-		{
-			ResourceArray[i] = SimParameters.Bodies[i].Mass;
-		}
+IMPLEMENT_GLOBAL_SHADER(FNBodySimEnsemblePositionsCS, "/NBodySimShaders/Private/NBodySim.usf", "CalculateEnsemblePositionsCS", SF_Compute);
 
-		FRHIResourceCreateInfo CreateInfo(TEXT("RHICreateInfo_MassesBuffer"));
-		CreateInfo.ResourceArray = &ResourceArray;
 
-		MassesBuffer = RHICreateStructuredBuffer(sizeof(float), SimParameters.Bodies.Num() * sizeof(float), BUF_ShaderResource, CreateInfo);
-		MassesBufferSRV = RHICreateShaderResourceView(MassesBuffer);
+
+void FNBodySimCSBuffers::Initialize(TArrayView<const FBodyData> Bodies, TArrayView<const int32> NewToOldBodies)
+{
+	const int32 NumBodies = Bodies.Num();
+
+	TResourceArray<float> MassesArray;
+	TResourceArray<FVector2f> PositionsArray;
+	TResourceArray<FVector2f> VelocitiesArray;
+	MassesArray.SetNumUninitialized(NumBodies);
+	PositionsArray.SetNumUninitialized(NumBodies);
+	VelocitiesArray.SetNumUninitialized(NumBodies);
+
+	for (int i = 0; i < NumBodies; i++)
+	{
+		MassesArray[i] = Bodies[i].Mass;
+		PositionsArray[i] = Bodies[i].Position;
+		VelocitiesArray[i] = Bodies[i].Velocity;
 	}
 
-	if (!PositionsBuffer || !PositionsBufferUAV)
+	// Bodies kept from the previous buffers continue from their simulated state. Only happens when the body count changes.
+	if (PositionsBuffer && VelocitiesBuffer && NewToOldBodies.Num() == NumBodies)
 	{
-		TResourceArray<FVector2f> ResourceArray;
-		ResourceArray.Init(FVector2f::ZeroVector, SimParameters.Bodies.Num());
+		const uint32 OldBufferSize = PositionsBuffer->GetSize();
+		const int32 OldNumBodies = OldBufferSize / sizeof(FVector2f);
 
-		for (int i = 0; i < SimParameters.Bodies.Num(); i++)
+		const FVector2f* OldPositions = static_cast<const FVector2f*>(RHILockBuffer(PositionsBuffer, 0, OldBufferSize, RLM_ReadOnly));
+		const FVector2f* OldVelocities = static_cast<const FVector2f*>(RHILockBuffer(VelocitiesBuffer, 0, OldBufferSize, RLM_ReadOnly));
+
+		for (int i = 0; i < NumBodies; i++)
 		{
-			ResourceArray[i] = SimParameters.Bodies[i].Position;
+			const int32 OldIndex = NewToOldBodies[i];
+			if (OldIndex != INDEX_NONE && OldIndex < OldNumBodies)
+			{
+				PositionsArray[i] = OldPositions[OldIndex];
+				VelocitiesArray[i] = OldVelocities[OldIndex];
+			}
 		}
 
-		FRHIResourceCreateInfo CreateInfo(TEXT("RHICreateInfo_PositionsBuffer"));
-		CreateInfo.ResourceArray = &ResourceArray;
+		RHIUnlockBuffer(VelocitiesBuffer);
+		RHIUnlockBuffer(PositionsBuffer);
+	}
 
-		PositionsBuffer = RHICreateStructuredBuffer(sizeof(FVector2f), SimParameters.Bodies.Num() * sizeof(FVector2f), BUF_UnorderedAccess | BUF_ShaderResource, CreateInfo);
-		PositionsBufferUAV = RHICreateUnorderedAccessView(PositionsBuffer, false, true);
+	Release();
+
+	{
+		FRHIResourceCreateInfo CreateInfo(TEXT("RHICreateInfo_MassesBuffer"));
+		CreateInfo.ResourceArray = &MassesArray;
+
+		MassesBuffer = RHICreateStructuredBuffer(sizeof(float), NumBodies * sizeof(float), BUF_ShaderResource, CreateInfo);
+		MassesBufferSRV = RHICreateShaderResourceView(MassesBuffer);
 	}
 
-	if (!VelocitiesBuffer || !VelocitiesBufferUAV)
 	{
-		TResourceArray<FVector2f> ResourceArray;
-		ResourceArray.Init(FVector2f::ZeroVector, SimParameters.Bodies.Num());
+		FRHIResourceCreateInfo CreateInfo(TEXT("RHICreateInfo_PositionsBuffer"));
+		CreateInfo.ResourceArray = &PositionsArray;
 
-		for (int i = 0; i < SimParameters.Bodies.Num(); i++)
-		{
-			ResourceArray[i] = SimParameters.Bodies[i].Velocity;
-		}
+		PositionsBuffer = RHICreateStructuredBuffer(sizeof(FVector2f), NumBodies * sizeof(FVector2f), BUF_UnorderedAccess | BUF_ShaderResource, CreateInfo);
+		PositionsBufferUAV = RHICreateUnorderedAccessView(PositionsBuffer, false, true);
+	}
 
+	{
 		FRHIResourceCreateInfo CreateInfo(TEXT("RHICreateInfo_VelocitiesBuffer"));
-		CreateInfo.ResourceArray = &ResourceArray;
+		CreateInfo.ResourceArray = &VelocitiesArray;
 
-		VelocitiesBuffer = RHICreateStructuredBuffer(sizeof(FVector2f), SimParameters.Bodies.Num() * sizeof(FVector2f), BUF_UnorderedAccess | BUF_ShaderResource, CreateInfo);
+		VelocitiesBuffer = RHICreateStructuredBuffer(sizeof(FVector2f), NumBodies * sizeof(FVector2f), BUF_UnorderedAccess | BUF_ShaderResource, CreateInfo);
 		VelocitiesBufferUAV = RHICreateUnorderedAccessView(VelocitiesBuffer, false, true);
 	}
 }
 
+void FNBodySimCSBuffers::UpdateMasses(TArrayView<const float> Masses)
+{
+	check(MassesBuffer && MassesBuffer->GetSize() == Masses.Num() * sizeof(float));
+
+	void* RawMasses = RHILockBuffer(MassesBuffer, 0, MassesBuffer->GetSize(), RLM_WriteOnly);
+	FMemory::Memcpy(RawMasses, Masses.GetData(), Masses.Num() * sizeof(float));
+	RHIUnlockBuffer(MassesBuffer);
+}
+
 void FNBodySimCSBuffers::Release()
 {
 	if (MassesBuffer)			MassesBuffer.SafeRelease();
@@ -129,7 +202,90 @@ void FNBodySimCSBuffers::Release()
 	if (VelocitiesBufferUAV)	VelocitiesBufferUAV.SafeRelease();
 }
 
-void FNBodySimCSInterface::RunComputeBodyPositions_RenderThread(FRHICommandListImmediate& RHICmdList, FNBodySimParameters& SimParameters, FNBodySimCSBuffers Buffers)
+void FNBodySimEnsembleCSBuffers::Initialize(const FNBodySimEnsemble& Ensemble)
+{
+	const int32 TotalBodies = Ensemble.NumBodies();
+
+	if (!MassesBuffer || !MassesBufferSRV)
+	{
+		TResourceArray<float> ResourceArray;
+		ResourceArray.Append(Ensemble.Masses);
+
+		FRHIResourceCreateInfo CreateInfo(TEXT("RHICreateInfo_EnsembleMassesBuffer"));
+		CreateInfo.ResourceArray = &ResourceArray;
+
+		MassesBuffer = RHICreateStructuredBuffer(sizeof(float), TotalBodies * sizeof(float), BUF_ShaderResource, CreateInfo);
+		MassesBufferSRV = RHICreateShaderResourceView(MassesBuffer);
+	}
+
+	if (!PositionsBuffer || !PositionsBufferUAV)
+	{
+		TResourceArray<FVector2f> ResourceArray;
+		ResourceArray.Append(Ensemble.Positions);
+
+		FRHIResourceCreateInfo CreateInfo(TEXT("RHICreateInfo_EnsemblePositionsBuffer"));
+		CreateInfo.ResourceArray = &ResourceArray;
+
+		PositionsBuffer = RHICreateStructuredBuffer(sizeof(FVector2f), TotalBodies * sizeof(FVector2f), BUF_UnorderedAccess | BUF_ShaderResource, CreateInfo);
+		PositionsBufferUAV = RHICreateUnorderedAccessView(PositionsBuffer, false, true);
+	}
+
+	if (!VelocitiesBuffer || !VelocitiesBufferUAV)
+	{
+		TResourceArray<FVector2f> ResourceArray;
+		ResourceArray.Append(Ensemble.Velocities);
+
+		FRHIResourceCreateInfo CreateInfo(TEXT("RHICreateInfo_EnsembleVelocitiesBuffer"));
+		CreateInfo.ResourceArray = &ResourceArray;
+
+		VelocitiesBuffer = RHICreateStructuredBuffer(sizeof(FVector2f), TotalBodies * sizeof(FVector2f), BUF_UnorderedAccess | BUF_ShaderResource, CreateInfo);
+		VelocitiesBufferUAV = RHICreateUnorderedAccessView(VelocitiesBuffer, false, true);
+	}
+
+	if (!SystemsBuffer || !SystemsBufferSRV)
+	{
+		TResourceArray<FNBodySimSystemConstants> ResourceArray;
+		ResourceArray.Append(Ensemble.Systems);
+
+		FRHIResourceCreateInfo CreateInfo(TEXT("RHICreateInfo_EnsembleSystemsBuffer"));
+		CreateInfo.ResourceArray = &ResourceArray;
+
+		SystemsBuffer = RHICreateStructuredBuffer(sizeof(FNBodySimSystemConstants), Ensemble.NumSystems() * sizeof(FNBodySimSystemConstants), BUF_ShaderResource, CreateInfo);
+		SystemsBufferSRV = RHICreateShaderResourceView(SystemsBuffer);
+	}
+
+	if (!BodySystemIndicesBuffer || !BodySystemIndicesBufferSRV)
+	{
+		TResourceArray<uint32> ResourceArray;
+		ResourceArray.Append(Ensemble.BodySystemIndices);
+
+		FRHIResourceCreateInfo CreateInfo(TEXT("RHICreateInfo_EnsembleBodySystemIndicesBuffer"));
+		CreateInfo.ResourceArray = &ResourceArray;
+
+		BodySystemIndicesBuffer = RHICreateStructuredBuffer(sizeof(uint32), TotalBodies * sizeof(uint32), BUF_ShaderResource, CreateInfo);
+		BodySystemIndicesBufferSRV = RHICreateShaderResourceView(BodySystemIndicesBuffer);
+	}
+}
+
+void FNBodySimEnsembleCSBuffers::Release()
+{
+	if (MassesBuffer)					MassesBuffer.SafeRelease();
+	if (MassesBufferSRV)				MassesBufferSRV.SafeRelease();
+
+	if (PositionsBuffer)				PositionsBuffer.SafeRelease();
+	if (PositionsBufferUAV)				PositionsBufferUAV.SafeRelease();
+
+	if (VelocitiesBuffer)				VelocitiesBuffer.SafeRelease();
+	if (VelocitiesBufferUAV)			VelocitiesBufferUAV.SafeRelease();
+
+	if (SystemsBuffer)					SystemsBuffer.SafeRelease();
+	if (SystemsBufferSRV)				SystemsBufferSRV.SafeRelease();
+
+	if (BodySystemIndicesBuffer)		BodySystemIndicesBuffer.SafeRelease();
+	if (BodySystemIndicesBufferSRV)		BodySystemIndicesBufferSRV.SafeRelease();
+}
+
+void FNBodySimCSInterface::RunComputeBodyPositions_RenderThread(FRHICommandListImmediate& RHICmdList, const FNBodySimSystemConstants& Constants, FNBodySimCSBuffers Buffers)
 {
 	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_ComputeBodyPositions); // Used to gather CPU profiling data for the UE4 session frontend
 	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_ComputeBodyPositions); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
@@ -149,19 +305,67 @@ void FNBodySimCSInterface::RunComputeBodyPositions_RenderThread(FRHICommandListI
 	PassParameters.Positions = Buffers.PositionsBufferUAV;
 	PassParameters.Velocities = Buffers.VelocitiesBufferUAV;
 
-	PassParameters.NumBodies = SimParameters.NumBodies;
-	PassParameters.GravityConstant = SimParameters.GravityConstant;
-	PassParameters.CameraAspectRatio = SimParameters.CameraAspectRatio;
-	PassParameters.ViewportWidth = SimParameters.ViewportWidth;
-	PassParameters.DeltaTime = SimParameters.DeltaTime;
+	PassParameters.NumBodies = Constants.NumBodies;
+	PassParameters.GravityConstant = Constants.GravityConstant;
+	PassParameters.CameraAspectRatio = Constants.CameraAspectRatio;
+	PassParameters.ViewportWidth = Constants.ViewportWidth;
+	PassParameters.DeltaTime = Constants.DeltaTime;
 
 
 	// Dispatch.
 	TShaderMapRef<FNBodySimCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
 
-	// FIntVector GroupCount = FComputeShaderUtils::GetGroupCount(ComputeGroupSize(SimParameters.NumBodies), FComputeShaderUtils::kGolden2DGroupSize);
+	// FIntVector GroupCount = FComputeShaderUtils::GetGroupCount(ComputeGroupSize(Constants.NumBodies), FComputeShaderUtils::kGolden2DGroupSize);
+
+	FComputeShaderUtils::Dispatch(RHICmdList, ComputeShader, PassParameters, ComputeGroupSize(Constants.NumBodies));
+}
+
+void FNBodySimCSInterface::BeginEnsembleSteps_RenderThread(FRHICommandListImmediate& RHICmdList, const FNBodySimEnsembleCSBuffers& Buffers)
+{
+	// Both passes write through the UAVs, the steps in between only need UAV barriers.
+	RHICmdList.Transition({
+		FRHITransitionInfo(Buffers.PositionsBufferUAV, ERHIAccess::Unknown, ERHIAccess::UAVCompute),
+		FRHITransitionInfo(Buffers.VelocitiesBufferUAV, ERHIAccess::Unknown, ERHIAccess::UAVCompute)
+	});
+}
+
+void FNBodySimCSInterface::EndEnsembleSteps_RenderThread(FRHICommandListImmediate& RHICmdList, const FNBodySimEnsembleCSBuffers& Buffers)
+{
+	RHICmdList.Transition({
+		FRHITransitionInfo(Buffers.PositionsBufferUAV, ERHIAccess::UAVCompute, ERHIAccess::CPURead),
+		FRHITransitionInfo(Buffers.VelocitiesBufferUAV, ERHIAccess::UAVCompute, ERHIAccess::CPURead)
+	});
+}
+
+void FNBodySimCSInterface::RunComputeEnsemblePositions_RenderThread(FRHICommandListImmediate& RHICmdList, const FNBodySimEnsemble& Ensemble, const FNBodySimEnsembleCSBuffers& Buffers)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_ComputeEnsemblePositions);
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_ComputeEnsemblePositions);
+
+	// Shader Parameters setup.
+	FNBodySimEnsembleCS::FParameters PassParameters;
+	PassParameters.Masses = Buffers.MassesBufferSRV;
+	PassParameters.Positions = Buffers.PositionsBufferUAV;
+	PassParameters.Velocities = Buffers.VelocitiesBufferUAV;
+	PassParameters.Systems = Buffers.SystemsBufferSRV;
+	PassParameters.BodySystemIndices = Buffers.BodySystemIndicesBufferSRV;
+	PassParameters.TotalNumBodies = Ensemble.NumBodies();
+
+	/**
+	 *	Dispatch, one thread per body of every system, in two passes: moving a body while other threads
+	 *	still read its position to compute their forces would be a data race.
+	 */
+	TShaderMapRef<FNBodySimEnsembleCS> VelocitiesShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	FComputeShaderUtils::Dispatch(RHICmdList, VelocitiesShader, PassParameters, ComputeGroupSize(Ensemble.NumBodies()));
+
+	// Every velocity must be written before the position pass reads them.
+	RHICmdList.Transition(FRHITransitionInfo(Buffers.VelocitiesBufferUAV, ERHIAccess::UAVCompute, ERHIAccess::UAVCompute));
+
+	TShaderMapRef<FNBodySimEnsemblePositionsCS> PositionsShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	FComputeShaderUtils::Dispatch(RHICmdList, PositionsShader, PassParameters, ComputeGroupSize(Ensemble.NumBodies()));
 
-	FComputeShaderUtils::Dispatch(RHICmdList, ComputeShader, PassParameters, ComputeGroupSize(SimParameters.NumBodies));
+	// The next step's velocity pass reads the moved positions.
+	RHICmdList.Transition(FRHITransitionInfo(Buffers.PositionsBufferUAV, ERHIAccess::UAVCompute, ERHIAccess::UAVCompute));
 }
 
 FIntVector FNBodySimCSInterface::ComputeGroupSize(uint32 NumBodies)
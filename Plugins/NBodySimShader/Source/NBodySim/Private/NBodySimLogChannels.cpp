@@ -0,0 +1,3 @@
+#include "NBodySimLogChannels.h"
+
+DEFINE_LOG_CATEGORY(LogNBodySim);
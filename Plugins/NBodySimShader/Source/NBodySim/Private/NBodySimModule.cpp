@@ -2,6 +2,7 @@
 
 #include "NBodySimModule.h"
 
+#include "Algo/Count.h"
 #include "Misc/Paths.h"
 #include "Misc/FileHelper.h"
 #include "RHI.h"
@@ -11,6 +12,9 @@
 #include "Runtime/Core/Public/Modules/ModuleManager.h"
 #include "Interfaces/IPluginManager.h"
 #include "NBodySimCS.h"
+#include "NBodySimCPU.h"
+#include "NBodySimLogChannels.h"
+#include "RenderingThread.h"
 
 IMPLEMENT_MODULE(FNBodySimModule, NBodySim)
 
@@ -70,19 +74,81 @@ void FNBodySimModule::EndRendering()
 	CSBuffers.Release();
 }
 
-void FNBodySimModule::InitWithParameters(FNBodySimParameters& SimParameters)
+void FNBodySimModule::InitWithParameters(const FNBodySimParameters& SimParameters)
 {
-	CachedNBodySimParameters = SimParameters;
+	RenderEveryFrameLock.Lock();
+	CachedConstants.FirstBody = 0;
+	CachedConstants.NumBodies = SimParameters.Bodies.Num();
+	CachedConstants.GravityConstant = SimParameters.GravityConstant;
+	CachedConstants.CameraAspectRatio = SimParameters.CameraAspectRatio;
+	CachedConstants.ViewportWidth = SimParameters.ViewportWidth;
+	CachedConstants.DeltaTime = SimParameters.DeltaTime;
+
+	PendingBodies = SimParameters.Bodies;
+	PendingNewToOldBodies.Reset();
+	bBodiesPending = true;
+	bResizePending = true;
+	RenderEveryFrameLock.Unlock();
+
 	bCachedParametersValid = true;
 }
 
 void FNBodySimModule::UpdateDeltaTime(float DeltaTime)
 {
 	RenderEveryFrameLock.Lock();
-	CachedNBodySimParameters.DeltaTime = DeltaTime;
+	CachedConstants.DeltaTime = DeltaTime;
+	RenderEveryFrameLock.Unlock();
+}
+
+void FNBodySimModule::UpdateConstants(float GravityConstant, float CameraAspectRatio, float ViewportWidth)
+{
+	RenderEveryFrameLock.Lock();
+	CachedConstants.GravityConstant = GravityConstant;
+	CachedConstants.CameraAspectRatio = CameraAspectRatio;
+	CachedConstants.ViewportWidth = ViewportWidth;
+	RenderEveryFrameLock.Unlock();
+}
+
+void FNBodySimModule::ResizeBodies(const TArray<FBodyData>& Bodies, const TArray<int32>& NewToOldBodies)
+{
+	check(Bodies.Num() == NewToOldBodies.Num());
+
+	RenderEveryFrameLock.Lock();
+	CachedConstants.NumBodies = Bodies.Num();
+	PendingBodies = Bodies;
+	PendingNewToOldBodies = NewToOldBodies;
+	PendingMasses.Reset();
+	bBodiesPending = true;
+	bResizePending = true;
 	RenderEveryFrameLock.Unlock();
 }
 
+void FNBodySimModule::UpdateMasses(const TArray<float>& Masses)
+{
+	RenderEveryFrameLock.Lock();
+	check(Masses.Num() == CachedConstants.NumBodies);
+
+	// Bodies not uploaded yet take the masses directly.
+	if (bBodiesPending)
+	{
+		for (int32 Index = 0; Index < Masses.Num(); ++Index)
+		{
+			PendingBodies[Index].Mass = Masses[Index];
+		}
+	}
+	else
+	{
+		PendingMasses = Masses;
+	}
+	RenderEveryFrameLock.Unlock();
+}
+
+bool FNBodySimModule::IsResizePending()
+{
+	FScopeLock Lock(&RenderEveryFrameLock);
+	return bResizePending;
+}
+
 void FNBodySimModule::PostResolveSceneColor_RenderThread(FRDGBuilder& Builder, const FSceneTextures& SceneTexture)
 {
 	if (!bCachedParametersValid)
@@ -90,15 +156,50 @@ void FNBodySimModule::PostResolveSceneColor_RenderThread(FRDGBuilder& Builder, c
 		return;
 	}
 	
-	// Depending on your data, you might not have to lock here, just added this code to show how you can do it if you have to.
 	RenderEveryFrameLock.Lock();
-	FNBodySimParameters Copy = CachedNBodySimParameters;
+	const FNBodySimSystemConstants Constants = CachedConstants;
+
+	// Body count and buffers change together, so a dispatch never sees one without the other.
+	const bool bReallocated = bBodiesPending;
+	double ReallocationSeconds = 0.0;
+	int32 OldNumBodies = 0;
+	int32 NumKeptBodies = 0;
+
+	if (bBodiesPending)
+	{
+		QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_ReallocateBodies);
+
+		const double StartTime = FPlatformTime::Seconds();
+		OldNumBodies = CSBuffers.PositionsBuffer ? CSBuffers.PositionsBuffer->GetSize() / sizeof(FVector2f) : 0;
+		NumKeptBodies = PendingNewToOldBodies.Num() - Algo::Count(PendingNewToOldBodies, INDEX_NONE);
+
+		CSBuffers.Initialize(PendingBodies, PendingNewToOldBodies);
+		PendingBodies.Empty();
+		PendingNewToOldBodies.Empty();
+		bBodiesPending = false;
+
+		ReallocationSeconds = FPlatformTime::Seconds() - StartTime;
+	}
+	else if (PendingMasses.Num() > 0)
+	{
+		QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_UpdateMasses);
+
+		CSBuffers.UpdateMasses(PendingMasses);
+		PendingMasses.Empty();
+	}
 	RenderEveryFrameLock.Unlock();
 
-	ComputeSimulation_RenderThread(CachedNBodySimParameters);
+	// The game thread only logs its own share of a resize, reading back and recreating the buffers happens here.
+	if (bReallocated)
+	{
+		UE_LOG(LogNBodySim, Log, TEXT("Reallocated bodies buffers on the render thread in %.3f ms : %d -> %d bodies, %d carried over."),
+			ReallocationSeconds * 1000.0, OldNumBodies, Constants.NumBodies, NumKeptBodies);
+	}
+
+	ComputeSimulation_RenderThread(Constants);
 }
 
-void FNBodySimModule::ComputeSimulation_RenderThread(FNBodySimParameters& SimParameters)
+void FNBodySimModule::ComputeSimulation_RenderThread(const FNBodySimSystemConstants& Constants)
 {
 	check(IsInRenderingThread());
 	
@@ -107,21 +208,68 @@ void FNBodySimModule::ComputeSimulation_RenderThread(FNBodySimParameters& SimPar
 	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_ComputeSimulation); // Used to gather CPU profiling data for the UE session frontend
 	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_ComputeSimulation); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
 
-	CSBuffers.Initialize(SimParameters);
-	
-	FNBodySimCSInterface::RunComputeBodyPositions_RenderThread(RHICmdList, SimParameters, CSBuffers);
+	FNBodySimCSInterface::RunComputeBodyPositions_RenderThread(RHICmdList, Constants, CSBuffers);
 
 	RenderEveryFrameLock.Lock();
 	{
 		// Get readback data into CPU readable struct.
-		void* RawBufferData = RHILockBuffer(CSBuffers.PositionsBuffer, 0, SimParameters.NumBodies * sizeof(FVector2f), RLM_ReadOnly);
+		void* RawBufferData = RHILockBuffer(CSBuffers.PositionsBuffer, 0, Constants.NumBodies * sizeof(FVector2f), RLM_ReadOnly);
 
-		if (OutputPositions.Num() != SimParameters.NumBodies)
-			OutputPositions.SetNumUninitialized(SimParameters.NumBodies);
+		if (OutputPositions.Num() != Constants.NumBodies)
+			OutputPositions.SetNumUninitialized(Constants.NumBodies);
 		
-		FMemory::Memcpy(OutputPositions.GetData(), RawBufferData, SimParameters.NumBodies * sizeof(FVector2f));
+		FMemory::Memcpy(OutputPositions.GetData(), RawBufferData, Constants.NumBodies * sizeof(FVector2f));
 	
 		RHIUnlockBuffer(CSBuffers.PositionsBuffer);
+
+		// Positions of the new bodies are out, unless yet another resize came in since.
+		bResizePending = bBodiesPending;
 	}
 	RenderEveryFrameLock.Unlock();
 }
+
+void FNBodySimModule::SimulateEnsemble(FNBodySimEnsemble& Ensemble, int32 NumSteps, ENBodySimBackend Backend)
+{
+	if (Ensemble.NumBodies() == 0 || NumSteps <= 0)
+	{
+		return;
+	}
+
+	if (Backend == ENBodySimBackend::CPU)
+	{
+		FNBodySimCPUInterface::StepEnsemble(Ensemble, NumSteps);
+		return;
+	}
+
+	FNBodySimEnsemble* EnsemblePtr = &Ensemble;
+	ENQUEUE_RENDER_COMMAND(NBodySimEnsemble)([EnsemblePtr, NumSteps](FRHICommandListImmediate& RHICmdList)
+	{
+		QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_SimulateEnsemble);
+
+		FNBodySimEnsembleCSBuffers Buffers;
+		Buffers.Initialize(*EnsemblePtr);
+
+		FNBodySimCSInterface::BeginEnsembleSteps_RenderThread(RHICmdList, Buffers);
+		for (int32 Step = 0; Step < NumSteps; ++Step)
+		{
+			FNBodySimCSInterface::RunComputeEnsemblePositions_RenderThread(RHICmdList, *EnsemblePtr, Buffers);
+		}
+		FNBodySimCSInterface::EndEnsembleSteps_RenderThread(RHICmdList, Buffers);
+
+		// Read back the whole state so the ensemble can be resumed or repacked from CPU.
+		const uint32 BufferSize = EnsemblePtr->NumBodies() * sizeof(FVector2f);
+
+		void* RawPositions = RHILockBuffer(Buffers.PositionsBuffer, 0, BufferSize, RLM_ReadOnly);
+		FMemory::Memcpy(EnsemblePtr->Positions.GetData(), RawPositions, BufferSize);
+		RHIUnlockBuffer(Buffers.PositionsBuffer);
+
+		void* RawVelocities = RHILockBuffer(Buffers.VelocitiesBuffer, 0, BufferSize, RLM_ReadOnly);
+		FMemory::Memcpy(EnsemblePtr->Velocities.GetData(), RawVelocities, BufferSize);
+		RHIUnlockBuffer(Buffers.VelocitiesBuffer);
+
+		Buffers.Release();
+	});
+
+	// The caller owns the ensemble, wait until the render thread is done with it.
+	FlushRenderingCommands();
+}
@@ -2,7 +2,9 @@
 
 #include "CoreMinimal.h"
 
-struct FNBodySimParameters;
+struct FBodyData;
+struct FNBodySimEnsemble;
+struct FNBodySimSystemConstants;
 
 /**
  *	Holds input/output buffers of the NBodySim compute shader.
@@ -19,7 +21,39 @@ struct FNBodySimCSBuffers
 	FBufferRHIRef VelocitiesBuffer;
 	FUnorderedAccessViewRHIRef VelocitiesBufferUAV;
 	
-	void Initialize(const FNBodySimParameters& SimParameters);
+	/**
+	 *	(Re)create the buffers from Bodies. If given, body i instead keeps the simulated position and
+	 *	velocity of body NewToOldBodies[i] of the previous buffers, unless INDEX_NONE.
+	 */
+	void Initialize(TArrayView<const FBodyData> Bodies, TArrayView<const int32> NewToOldBodies = TArrayView<const int32>());
+
+	// Overwrite the masses in place, one per body of the current buffers.
+	void UpdateMasses(TArrayView<const float> Masses);
+
+	void Release();
+};
+
+/**
+ *	Holds input/output buffers of the ensemble compute shader, every system packed one after another.
+ */
+struct FNBodySimEnsembleCSBuffers
+{
+	FBufferRHIRef MassesBuffer;
+	FShaderResourceViewRHIRef MassesBufferSRV;
+
+	FBufferRHIRef PositionsBuffer;
+	FUnorderedAccessViewRHIRef PositionsBufferUAV;
+
+	FBufferRHIRef VelocitiesBuffer;
+	FUnorderedAccessViewRHIRef VelocitiesBufferUAV;
+
+	FBufferRHIRef SystemsBuffer;
+	FShaderResourceViewRHIRef SystemsBufferSRV;
+
+	FBufferRHIRef BodySystemIndicesBuffer;
+	FShaderResourceViewRHIRef BodySystemIndicesBufferSRV;
+
+	void Initialize(const FNBodySimEnsemble& Ensemble);
 	void Release();
 };
 
@@ -29,7 +63,16 @@ struct FNBodySimCSBuffers
 class FNBodySimCSInterface
 {
 public:
-	static void RunComputeBodyPositions_RenderThread(FRHICommandListImmediate& RHICmdList, FNBodySimParameters& SimParameters, FNBodySimCSBuffers Buffers);
+	static void RunComputeBodyPositions_RenderThread(FRHICommandListImmediate& RHICmdList, const FNBodySimSystemConstants& Constants, FNBodySimCSBuffers Buffers);
+
+	// Move the ensemble buffers to UAV access once, before the first step.
+	static void BeginEnsembleSteps_RenderThread(FRHICommandListImmediate& RHICmdList, const FNBodySimEnsembleCSBuffers& Buffers);
+
+	// Advance all systems of the ensemble by one step, with a velocity dispatch then a position dispatch.
+	static void RunComputeEnsemblePositions_RenderThread(FRHICommandListImmediate& RHICmdList, const FNBodySimEnsemble& Ensemble, const FNBodySimEnsembleCSBuffers& Buffers);
+
+	// Make the ensemble buffers readable from CPU once the last step is done.
+	static void EndEnsembleSteps_RenderThread(FRHICommandListImmediate& RHICmdList, const FNBodySimEnsembleCSBuffers& Buffers);
 
 private:
 	static FIntVector ComputeGroupSize(uint32 NumBodies);
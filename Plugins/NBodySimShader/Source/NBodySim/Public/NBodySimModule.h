@@ -4,27 +4,12 @@
 
 #include "CoreMinimal.h"
 #include "NBodySimCS.h"
+#include "NBodySimEnsemble.h"
 #include "NBodySimTypesDefinitions.h"
 #include "RenderGraphResources.h"
 #include "Modules/ModuleInterface.h"
 #include "Modules/ModuleManager.h"
 
-// This struct contains all the data we need to pass from the game thread to compute on GPU.
-struct FNBodySimParameters
-{
-public:
-	TArray<FBodyData> Bodies;
-	uint32 NumBodies;
-	float GravityConstant;
-	float CameraAspectRatio;
-	float ViewportWidth;
-	float DeltaTime;
-	
-	FNBodySimParameters(): NumBodies(0), GravityConstant(0), CameraAspectRatio(0), ViewportWidth(0), DeltaTime(0)
-	{
-	}
-};
-
 /*
  * Since we already have a module interface due to us being in a plugin, it's pretty handy to just use it
  * to interact with the renderer. It gives us the added advantage of being able to decouple any render
@@ -53,27 +38,62 @@ public:
 
 	// When you are done, call this to stop drawing.
 	void EndRendering();
-	void InitWithParameters(FNBodySimParameters& SimParameters);
+
+	// Hand the bodies and constants over to the renderer. Bodies are uploaded once, by the next frame.
+	void InitWithParameters(const FNBodySimParameters& SimParameters);
 
 	// Call this whenever you have new parameters to share. You could set this up to update different sets of properties at
 	// different intervals to save on locking and GPU transfer time.
 	void UpdateDeltaTime(float DeltaTime);
 
+	// Push new simulation constants from the next frame on. Only the constants are copied, bodies buffers are left untouched.
+	void UpdateConstants(float GravityConstant, float CameraAspectRatio, float ViewportWidth);
+
+	/**
+	 *	Change the bodies, reallocating the buffers by the next frame. Body i keeps the simulated state of
+	 *	body NewToOldBodies[i], or starts from Bodies[i] when INDEX_NONE.
+	 */
+	void ResizeBodies(const TArray<FBodyData>& Bodies, const TArray<int32>& NewToOldBodies);
+
+	// Push new body masses from the next frame on, one per body. Uploaded into the current buffers, without reallocating them.
+	void UpdateMasses(const TArray<float>& Masses);
+
 	TArray<FVector2f> GetComputedPositions() { return OutputPositions; }
 
+	// Whether new bodies were handed over but GetComputedPositions() does not return their positions yet.
+	bool IsResizePending();
+
+	/**
+	 *	Advance every system of the ensemble by NumSteps, blocking until results are written back into Ensemble.
+	 *	Runs one dispatch per step on GPU or one ParallelFor per step on CPU, independently of BeginRendering().
+	 */
+	void SimulateEnsemble(FNBodySimEnsemble& Ensemble, int32 NumSteps, ENBodySimBackend Backend);
+
 private:
 	void PostResolveSceneColor_RenderThread(FRDGBuilder& Builder, const FSceneTextures& SceneTexture);
 
 
-	void ComputeSimulation_RenderThread(FNBodySimParameters& SimParameters);
+	void ComputeSimulation_RenderThread(const FNBodySimSystemConstants& Constants);
 	
 	
 	FDelegateHandle OnPostResolvedSceneColorHandle;
 	FCriticalSection RenderEveryFrameLock;
 
-	FNBodySimParameters CachedNBodySimParameters;
+	// Constants of the next dispatch, the only data copied to the render thread every frame.
+	FNBodySimSystemConstants CachedConstants;
 	volatile bool bCachedParametersValid = false;
 
+	// Bodies waiting to be uploaded by the render thread, emptied once they are.
+	TArray<FBodyData> PendingBodies;
+	TArray<int32> PendingNewToOldBodies;
+	bool bBodiesPending = false;
+
+	// Masses waiting to be uploaded into the current buffers, empty when none.
+	TArray<float> PendingMasses;
+
+	// Set with the pending bodies, cleared once the output positions are read back with their body count.
+	bool bResizePending = false;
+
 	FNBodySimCSBuffers CSBuffers;
 	
 	TArray<FVector2f> OutputPositions;
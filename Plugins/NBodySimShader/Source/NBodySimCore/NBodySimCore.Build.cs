@@ -0,0 +1,19 @@
+
+
+namespace UnrealBuildTool.Rules
+{
+	public class NBodySimCore : ModuleRules
+	{
+		public NBodySimCore(ReadOnlyTargetRules Target)
+			: base(Target)
+		{
+			PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+
+			// Keep this module free of Engine/Renderer dependencies so the solver can run headless.
+			PublicDependencyModuleNames.AddRange(new string[]
+			{
+				"Core"
+			});
+		}
+	}
+}
@@ -0,0 +1,50 @@
+
+
+#include "NBodySimCPU.h"
+
+#include "Async/ParallelFor.h"
+#include "NBodySimEnsemble.h"
+#include "NBodySimKernels.h"
+
+DECLARE_STATS_GROUP(TEXT("NBodySimCPU"), STATGROUP_NBodySimCPU, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("NBodySimCPU StepEnsemble"), STAT_NBodySimCPU_StepEnsemble, STATGROUP_NBodySimCPU);
+
+void FNBodySimCPUInterface::StepEnsemble(FNBodySimEnsemble& Ensemble, int32 NumSteps)
+{
+	SCOPE_CYCLE_COUNTER(STAT_NBodySimCPU_StepEnsemble);
+
+	const int32 TotalBodies = Ensemble.NumBodies();
+	if (TotalBodies == 0)
+	{
+		return;
+	}
+
+	const float* Masses = Ensemble.Masses.GetData();
+	FVector2f* Positions = Ensemble.Positions.GetData();
+	FVector2f* Velocities = Ensemble.Velocities.GetData();
+	const uint32* BodySystemIndices = Ensemble.BodySystemIndices.GetData();
+	const FNBodySimSystemConstants* Systems = Ensemble.Systems.GetData();
+
+	for (int32 Step = 0; Step < NumSteps; ++Step)
+	{
+		/**
+		 *	Like the ensemble compute shader, velocities and positions are updated in two passes:
+		 *	writing positions while other workers read them would be a data race.
+		 */
+		ParallelFor(TotalBodies, [=](int32 BodyID)
+		{
+			const FNBodySimSystemConstants& System = Systems[BodySystemIndices[BodyID]];
+
+			const FVector2f Acceleration = FNBodySimKernels::ComputeAcceleration(BodyID, System.FirstBody, System.NumBodies, Masses, Positions, System.GravityConstant);
+			Velocities[BodyID] += Acceleration * System.DeltaTime;
+		});
+
+		ParallelFor(TotalBodies, [=](int32 BodyID)
+		{
+			const FNBodySimSystemConstants& System = Systems[BodySystemIndices[BodyID]];
+
+			const FVector2f Position = Positions[BodyID] + Velocities[BodyID] * System.DeltaTime;
+			Positions[BodyID] = FNBodySimKernels::WrapPosition(Position, System.ViewportWidth, System.CameraAspectRatio);
+		});
+	}
+}
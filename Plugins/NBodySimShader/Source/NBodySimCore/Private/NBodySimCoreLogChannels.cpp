@@ -0,0 +1,3 @@
+#include "NBodySimCoreLogChannels.h"
+
+DEFINE_LOG_CATEGORY(LogNBodySimCore);
@@ -0,0 +1,5 @@
+
+#include "Modules/ModuleManager.h"
+
+// The solver core has no module state, it only exposes plain C++ types.
+IMPLEMENT_MODULE(FDefaultModuleImpl, NBodySimCore)
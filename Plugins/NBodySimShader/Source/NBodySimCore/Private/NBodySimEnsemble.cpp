@@ -0,0 +1,65 @@
+
+
+#include "NBodySimEnsemble.h"
+
+#include "NBodySimTypesDefinitions.h"
+
+void FNBodySimEnsemble::Pack(const TArray<FNBodySimParameters>& InSystems)
+{
+	int32 TotalBodies = 0;
+	for (const FNBodySimParameters& System : InSystems)
+	{
+		TotalBodies += System.Bodies.Num();
+	}
+
+	Systems.SetNumUninitialized(InSystems.Num());
+	BodySystemIndices.SetNumUninitialized(TotalBodies);
+	Masses.SetNumUninitialized(TotalBodies);
+	Positions.SetNumUninitialized(TotalBodies);
+	Velocities.SetNumUninitialized(TotalBodies);
+
+	uint32 FirstBody = 0;
+	for (int32 SystemIndex = 0; SystemIndex < InSystems.Num(); ++SystemIndex)
+	{
+		const FNBodySimParameters& System = InSystems[SystemIndex];
+
+		FNBodySimSystemConstants& Constants = Systems[SystemIndex];
+		Constants.FirstBody = FirstBody;
+		Constants.NumBodies = System.Bodies.Num();
+		Constants.GravityConstant = System.GravityConstant;
+		Constants.CameraAspectRatio = System.CameraAspectRatio;
+		Constants.ViewportWidth = System.ViewportWidth;
+		Constants.DeltaTime = System.DeltaTime;
+
+		for (int32 i = 0; i < System.Bodies.Num(); i++)
+		{
+			const uint32 BodyIndex = FirstBody + i;
+			BodySystemIndices[BodyIndex] = SystemIndex;
+			Masses[BodyIndex] = System.Bodies[i].Mass;
+			Positions[BodyIndex] = System.Bodies[i].Position;
+			Velocities[BodyIndex] = System.Bodies[i].Velocity;
+		}
+
+		FirstBody += Constants.NumBodies;
+	}
+}
+
+void FNBodySimEnsemble::SetDeltaTime(float DeltaTime)
+{
+	for (FNBodySimSystemConstants& System : Systems)
+	{
+		System.DeltaTime = DeltaTime;
+	}
+}
+
+TArrayView<const FVector2f> FNBodySimEnsemble::GetSystemPositions(int32 SystemIndex) const
+{
+	const FNBodySimSystemConstants& System = Systems[SystemIndex];
+	return TArrayView<const FVector2f>(Positions.GetData() + System.FirstBody, System.NumBodies);
+}
+
+TArrayView<const FVector2f> FNBodySimEnsemble::GetSystemVelocities(int32 SystemIndex) const
+{
+	const FNBodySimSystemConstants& System = Systems[SystemIndex];
+	return TArrayView<const FVector2f>(Velocities.GetData() + System.FirstBody, System.NumBodies);
+}
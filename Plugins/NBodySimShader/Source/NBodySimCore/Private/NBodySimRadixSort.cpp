@@ -0,0 +1,96 @@
+#include "NBodySimRadixSort.h"
+
+#include "Async/ParallelFor.h"
+
+/** Bits sorted per pass, 4 passes for 32 bits keys. */
+static constexpr uint32 RadixBits = 8;
+static constexpr uint32 RadixSize = 1u << RadixBits;
+
+/** Number of keys histogrammed and scattered by a single task. */
+static constexpr int32 RadixChunkSize = 4096;
+
+void FNBodySimRadixSort::Sort(TArray<uint32>& Keys, TArray<int32>& Values, TArray<uint32>& TempKeys, TArray<int32>& TempValues)
+{
+	check(Keys.Num() == Values.Num());
+
+	const int32 Num = Keys.Num();
+	if (Num <= 1)
+	{
+		return;
+	}
+
+	TempKeys.SetNumUninitialized(Num, false);
+	TempValues.SetNumUninitialized(Num, false);
+
+	const int32 NumChunks = FMath::DivideAndRoundUp(Num, RadixChunkSize);
+
+	// One histogram per chunk, turned into per chunk scatter offsets.
+	TArray<uint32> ChunkOffsets;
+	ChunkOffsets.SetNumUninitialized(NumChunks * RadixSize);
+
+	for (uint32 Shift = 0; Shift < 32; Shift += RadixBits)
+	{
+		const uint32* SrcKeys = Keys.GetData();
+		const int32* SrcValues = Values.GetData();
+		uint32* DstKeys = TempKeys.GetData();
+		int32* DstValues = TempValues.GetData();
+		uint32* Offsets = ChunkOffsets.GetData();
+
+		ParallelFor(NumChunks, [=](int32 ChunkIndex)
+		{
+			uint32* Histogram = Offsets + ChunkIndex * RadixSize;
+			FMemory::Memzero(Histogram, RadixSize * sizeof(uint32));
+
+			const int32 ChunkEnd = FMath::Min((ChunkIndex + 1) * RadixChunkSize, Num);
+			for (int32 i = ChunkIndex * RadixChunkSize; i < ChunkEnd; ++i)
+			{
+				++Histogram[(SrcKeys[i] >> Shift) & (RadixSize - 1)];
+			}
+		});
+
+		// Skip the pass when every key has the same digit, common for the high bits of small grids.
+		bool bSingleDigit = false;
+		for (uint32 Digit = 0; Digit < RadixSize && !bSingleDigit; ++Digit)
+		{
+			uint32 DigitCount = 0;
+			for (int32 ChunkIndex = 0; ChunkIndex < NumChunks; ++ChunkIndex)
+			{
+				DigitCount += Offsets[ChunkIndex * RadixSize + Digit];
+			}
+			bSingleDigit = (DigitCount == static_cast<uint32>(Num));
+		}
+
+		if (bSingleDigit)
+		{
+			continue;
+		}
+
+		// Exclusive prefix sum, digit major then chunk, which keeps the sort stable.
+		uint32 Running = 0;
+		for (uint32 Digit = 0; Digit < RadixSize; ++Digit)
+		{
+			for (int32 ChunkIndex = 0; ChunkIndex < NumChunks; ++ChunkIndex)
+			{
+				const uint32 Count = Offsets[ChunkIndex * RadixSize + Digit];
+				Offsets[ChunkIndex * RadixSize + Digit] = Running;
+				Running += Count;
+			}
+		}
+
+		ParallelFor(NumChunks, [=](int32 ChunkIndex)
+		{
+			uint32* ChunkOffset = Offsets + ChunkIndex * RadixSize;
+
+			const int32 ChunkEnd = FMath::Min((ChunkIndex + 1) * RadixChunkSize, Num);
+			for (int32 i = ChunkIndex * RadixChunkSize; i < ChunkEnd; ++i)
+			{
+				const uint32 Destination = ChunkOffset[(SrcKeys[i] >> Shift) & (RadixSize - 1)]++;
+				DstKeys[Destination] = SrcKeys[i];
+				DstValues[Destination] = SrcValues[i];
+			}
+		});
+
+		Swap(Keys, TempKeys);
+		Swap(Values, TempValues);
+	}
+}
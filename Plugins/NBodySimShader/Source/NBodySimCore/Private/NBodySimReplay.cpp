@@ -0,0 +1,140 @@
+#include "NBodySimReplay.h"
+
+#include "NBodySimCoreLogChannels.h"
+
+FNBodySimReplay::FNBodySimReplay(FNBodySimSolver& InSolver, int32 InKeyframeInterval, SIZE_T MemoryBudget)
+	: Solver(InSolver)
+	, KeyframeInterval(FMath::Max(InKeyframeInterval, 1))
+	, LatestStep(InSolver.GetStepCount())
+{
+	if (!Solver.GetOptions().bDeterministic)
+	{
+		UE_LOG(LogNBodySimCore, Warning, TEXT("Replay recorded from a non deterministic solver, seeking may not reproduce the original run."));
+	}
+
+	const SIZE_T KeyframeSize = FNBodySimState::GetSizeForBodies(Solver.GetNumBodies());
+	const int32 MaxKeyframes = FMath::Max<int32>(1, MemoryBudget / KeyframeSize);
+	Keyframes.SetNum(MaxKeyframes);
+
+	UE_LOG(LogNBodySimCore, Log, TEXT("Replay keeps up to %d keyframes of %llu bytes, every %d steps."), MaxKeyframes, (uint64)KeyframeSize, KeyframeInterval);
+
+	// Always keep the starting point so the whole run can be replayed until the ring buffer wraps.
+	CaptureKeyframe();
+}
+
+void FNBodySimReplay::Step(int32 NumSteps)
+{
+	for (int32 i = 0; i < NumSteps; ++i)
+	{
+		// After stepping backward, go on from the exact state rather than from its approximation.
+		if (!bExact)
+		{
+			RestoreExactState();
+		}
+
+		Solver.Step();
+
+		// Only record steps never simulated before, revisited ones already have their keyframes.
+		const uint64 StepCount = Solver.GetStepCount();
+		if (bExact && StepCount > LatestStep)
+		{
+			LatestStep = StepCount;
+
+			if (StepCount % KeyframeInterval == 0)
+			{
+				CaptureKeyframe();
+			}
+		}
+	}
+}
+
+bool FNBodySimReplay::Seek(uint64 TargetStep)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_NBodySimReplay_Seek);
+
+	const uint64 CurrentStep = Solver.GetStepCount();
+
+	const int32 KeyframeSlot = FindKeyframe(TargetStep);
+	if (KeyframeSlot == INDEX_NONE)
+	{
+		UE_LOG(LogNBodySimCore, Warning, TEXT("Cannot seek to step %llu : oldest keyframe is at step %llu."), TargetStep, GetOldestStep());
+		return false;
+	}
+
+	/**
+	 *	Restore the keyframe unless simulating from the current state is shorter, which is only
+	 *	valid while the current state was reached by forward steps from a keyframe.
+	 */
+	const uint64 KeyframeStep = Keyframes[KeyframeSlot].StepCount;
+	if (!bExact || TargetStep < CurrentStep || KeyframeStep > CurrentStep)
+	{
+		Solver.RestoreState(Keyframes[KeyframeSlot]);
+		bExact = true;
+	}
+
+	// Resimulate headless, at full speed.
+	Step(static_cast<int32>(TargetStep - Solver.GetStepCount()));
+	return true;
+}
+
+bool FNBodySimReplay::StepBackward(int32 NumSteps)
+{
+	const uint64 CurrentStep = Solver.GetStepCount();
+	const uint64 TargetStep = CurrentStep > (uint64)NumSteps ? CurrentStep - NumSteps : 0;
+
+	if (Solver.GetOptions().Integrator == ENBodySimIntegrator::Leapfrog)
+	{
+		bExact = false;
+		return Solver.StepBackward(static_cast<int32>(CurrentStep - TargetStep));
+	}
+
+	return Seek(TargetStep);
+}
+
+bool FNBodySimReplay::RestoreExactState()
+{
+	// Once the ring buffer dropped the keyframes before the current step, stay approximate until the oldest one.
+	const uint64 CurrentStep = Solver.GetStepCount();
+	if (FindKeyframe(CurrentStep) == INDEX_NONE)
+	{
+		return false;
+	}
+	return Seek(CurrentStep);
+}
+
+uint64 FNBodySimReplay::GetOldestStep() const
+{
+	return NumKeyframes > 0 ? Keyframes[OldestKeyframe].StepCount : Solver.GetStepCount();
+}
+
+void FNBodySimReplay::CaptureKeyframe()
+{
+	int32 Slot;
+	if (NumKeyframes < Keyframes.Num())
+	{
+		Slot = (OldestKeyframe + NumKeyframes) % Keyframes.Num();
+		++NumKeyframes;
+	}
+	else
+	{
+		// Full, overwrite the oldest keyframe.
+		Slot = OldestKeyframe;
+		OldestKeyframe = (OldestKeyframe + 1) % Keyframes.Num();
+	}
+
+	Solver.SaveState(Keyframes[Slot]);
+}
+
+int32 FNBodySimReplay::FindKeyframe(uint64 Step) const
+{
+	// Keyframes are captured in increasing step order, search from the newest one.
+	for (int32 i = NumKeyframes - 1; i >= 0; --i)
+	{
+		const int32 Slot = (OldestKeyframe + i) % Keyframes.Num();
+		if (Keyframes[Slot].StepCount <= Step)
+		{
+			return Slot;
+		}
+	}
+	return INDEX_NONE;
+}
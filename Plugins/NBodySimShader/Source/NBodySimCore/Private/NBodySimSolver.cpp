@@ -0,0 +1,553 @@
+#include "NBodySimSolver.h"
+
+#include "NBodySimCoreLogChannels.h"
+#include "NBodySimKernels.h"
+#include "NBodySimRadixSort.h"
+#include "Misc/Crc.h"
+
+DECLARE_STATS_GROUP(TEXT("NBodySimSolver"), STATGROUP_NBodySimSolver, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("NBodySimSolver Step"), STAT_NBodySimSolver_Step, STATGROUP_NBodySimSolver);
+DECLARE_CYCLE_STAT(TEXT("NBodySimSolver ReorderBodies"), STAT_NBodySimSolver_ReorderBodies, STATGROUP_NBodySimSolver);
+
+/** Number of bodies handled by a single task in deterministic mode. */
+static constexpr int32 DeterministicChunkSize = 256;
+
+/** Deepest block timestep level, a step of DeltaTime / 2^16. */
+static constexpr int32 MaxTimestepLevelLimit = 16;
+
+TUniquePtr<FNBodySimSolver> FNBodySimSolver::Create(const FNBodySimParameters& Parameters, const FNBodySimSolverOptions& Options)
+{
+	if (Parameters.CameraAspectRatio <= 0.0f || Parameters.ViewportWidth <= 0.0f)
+	{
+		UE_LOG(LogNBodySimCore, Error, TEXT("Failed to create solver : invalid viewport (width %f, aspect ratio %f)."), Parameters.ViewportWidth, Parameters.CameraAspectRatio);
+		return nullptr;
+	}
+
+	return TUniquePtr<FNBodySimSolver>(new FNBodySimSolver(Parameters, Options));
+}
+
+FNBodySimSolver::FNBodySimSolver(const FNBodySimParameters& Parameters, const FNBodySimSolverOptions& InOptions)
+	: Options(InOptions)
+	, GravityConstant(Parameters.GravityConstant)
+	, CameraAspectRatio(Parameters.CameraAspectRatio)
+	, ViewportWidth(Parameters.ViewportWidth)
+	, DeltaTime(Parameters.DeltaTime)
+{
+	const int32 NumBodies = Parameters.Bodies.Num();
+
+	Masses.SetNumUninitialized(NumBodies);
+	Positions.SetNumUninitialized(NumBodies);
+	Velocities.SetNumUninitialized(NumBodies);
+	Accelerations.SetNumZeroed(NumBodies);
+	BodyIds.SetNumUninitialized(NumBodies);
+	IdToSlot.SetNumUninitialized(NumBodies);
+
+	Options.MaxTimestepLevel = FMath::Clamp(Options.MaxTimestepLevel, 0, MaxTimestepLevelLimit);
+
+	for (int32 i = 0; i < NumBodies; i++)
+	{
+		Masses[i] = Parameters.Bodies[i].Mass;
+		Positions[i] = Parameters.Bodies[i].Position;
+		Velocities[i] = Parameters.Bodies[i].Velocity;
+		BodyIds[i] = i;
+		IdToSlot[i] = i;
+	}
+}
+
+void FNBodySimSolver::Step(int32 NumSteps)
+{
+	SCOPE_CYCLE_COUNTER(STAT_NBodySimSolver_Step);
+
+	if (GetNumBodies() == 0)
+	{
+		return;
+	}
+
+	for (int32 i = 0; i < NumSteps; ++i)
+	{
+		switch (Options.Integrator)
+		{
+		case ENBodySimIntegrator::SemiImplicitEuler:
+			StepSemiImplicitEuler();
+			break;
+
+		case ENBodySimIntegrator::Leapfrog:
+			StepLeapfrog();
+			break;
+
+		case ENBodySimIntegrator::BlockTimesteps:
+			StepBlockTimesteps();
+			break;
+		}
+
+		++StepCount;
+
+		if (Options.ReorderInterval > 0 && StepCount % Options.ReorderInterval == 0)
+		{
+			ReorderBodies();
+		}
+
+		if (Options.StateHashInterval > 0 && StepCount % Options.StateHashInterval == 0)
+		{
+			const uint32 StateHash = ComputeStateHash();
+			UE_LOG(LogNBodySimCore, Verbose, TEXT("Step %llu state hash %08x"), StepCount, StateHash);
+
+			if (Options.OnStateHash)
+			{
+				Options.OnStateHash(StepCount, StateHash);
+			}
+		}
+	}
+}
+
+void FNBodySimSolver::SetGravityConstant(float InGravityConstant)
+{
+	GravityConstant = InGravityConstant;
+
+	// Cached accelerations were computed with the previous constant.
+	bAccelerationsValid = false;
+}
+
+void FNBodySimSolver::SetViewport(float InViewportWidth, float InCameraAspectRatio)
+{
+	if (InViewportWidth <= 0.0f || InCameraAspectRatio <= 0.0f)
+	{
+		UE_LOG(LogNBodySimCore, Warning, TEXT("Ignoring invalid viewport (width %f, aspect ratio %f)."), InViewportWidth, InCameraAspectRatio);
+		return;
+	}
+
+	// Bodies outside of a smaller screen wrap back in at their next drift.
+	ViewportWidth = InViewportWidth;
+	CameraAspectRatio = InCameraAspectRatio;
+}
+
+void FNBodySimSolver::ResizeBodies(TArrayView<const FBodyData> Bodies, TArrayView<const int32> NewToOldIds)
+{
+	check(Bodies.Num() == NewToOldIds.Num());
+
+	const int32 NumBodies = Bodies.Num();
+
+	TArray<float> NewMasses;
+	TArray<FVector2f> NewPositions;
+	TArray<FVector2f> NewVelocities;
+	NewMasses.SetNumUninitialized(NumBodies);
+	NewPositions.SetNumUninitialized(NumBodies);
+	NewVelocities.SetNumUninitialized(NumBodies);
+
+	for (int32 i = 0; i < NumBodies; i++)
+	{
+		const int32 OldId = NewToOldIds[i];
+		NewMasses[i] = Bodies[i].Mass;
+		if (IdToSlot.IsValidIndex(OldId))
+		{
+			const int32 OldSlot = IdToSlot[OldId];
+			NewPositions[i] = Positions[OldSlot];
+			NewVelocities[i] = Velocities[OldSlot];
+		}
+		else
+		{
+			NewPositions[i] = Bodies[i].Position;
+			NewVelocities[i] = Bodies[i].Velocity;
+		}
+	}
+
+	Masses = MoveTemp(NewMasses);
+	Positions = MoveTemp(NewPositions);
+	Velocities = MoveTemp(NewVelocities);
+	Accelerations.SetNumZeroed(NumBodies);
+
+	BodyIds.SetNumUninitialized(NumBodies);
+	IdToSlot.SetNumUninitialized(NumBodies);
+	for (int32 i = 0; i < NumBodies; i++)
+	{
+		BodyIds[i] = i;
+		IdToSlot[i] = i;
+	}
+
+	TimestepLevels.Reset();
+	bTimestepLevelsValid = false;
+	bAccelerationsValid = false;
+}
+
+void FNBodySimSolver::SetBodyMass(int32 BodyId, float Mass)
+{
+	check(IdToSlot.IsValidIndex(BodyId));
+
+	Masses[IdToSlot[BodyId]] = Mass;
+
+	// Every cached acceleration depends on this mass.
+	bAccelerationsValid = false;
+}
+
+bool FNBodySimSolver::StepBackward(int32 NumSteps)
+{
+	if (Options.Integrator != ENBodySimIntegrator::Leapfrog)
+	{
+		UE_LOG(LogNBodySimCore, Warning, TEXT("Cannot step backward : only the leapfrog integrator is time reversible."));
+		return false;
+	}
+
+	const float ForwardDeltaTime = DeltaTime;
+	DeltaTime = -ForwardDeltaTime;
+
+	for (int32 i = 0; i < NumSteps && StepCount > 0; ++i)
+	{
+		StepLeapfrog();
+		--StepCount;
+	}
+
+	DeltaTime = ForwardDeltaTime;
+	return true;
+}
+
+void FNBodySimSolver::SaveState(FNBodySimState& OutState) const
+{
+	OutState.StepCount = StepCount;
+	OutState.DeltaTime = DeltaTime;
+
+	// Keyframes are overwritten in place, avoid shrinking and reallocating them every capture.
+	OutState.Masses.SetNumUninitialized(Masses.Num(), false);
+	OutState.Positions.SetNumUninitialized(Positions.Num(), false);
+	OutState.Velocities.SetNumUninitialized(Velocities.Num(), false);
+
+	FMemory::Memcpy(OutState.Masses.GetData(), Masses.GetData(), Masses.Num() * sizeof(float));
+	FMemory::Memcpy(OutState.Positions.GetData(), Positions.GetData(), Positions.Num() * sizeof(FVector2f));
+	FMemory::Memcpy(OutState.Velocities.GetData(), Velocities.GetData(), Velocities.Num() * sizeof(FVector2f));
+
+	OutState.BodyIds.SetNumUninitialized(BodyIds.Num(), false);
+	FMemory::Memcpy(OutState.BodyIds.GetData(), BodyIds.GetData(), BodyIds.Num() * sizeof(int32));
+
+	// Levels depend on past jerks, they cannot be recomputed from the state alone.
+	const int32 NumLevels = bTimestepLevelsValid ? TimestepLevels.Num() : 0;
+	OutState.TimestepLevels.SetNumUninitialized(NumLevels, false);
+	FMemory::Memcpy(OutState.TimestepLevels.GetData(), TimestepLevels.GetData(), NumLevels * sizeof(int32));
+}
+
+void FNBodySimSolver::RestoreState(const FNBodySimState& State)
+{
+	check(State.Masses.Num() == GetNumBodies());
+
+	StepCount = State.StepCount;
+	DeltaTime = State.DeltaTime;
+	FMemory::Memcpy(Masses.GetData(), State.Masses.GetData(), Masses.Num() * sizeof(float));
+	FMemory::Memcpy(Positions.GetData(), State.Positions.GetData(), Positions.Num() * sizeof(FVector2f));
+	FMemory::Memcpy(Velocities.GetData(), State.Velocities.GetData(), Velocities.Num() * sizeof(FVector2f));
+
+	// The state may have been saved with another memory order, tell observers where bodies went.
+	if (FMemory::Memcmp(BodyIds.GetData(), State.BodyIds.GetData(), BodyIds.Num() * sizeof(int32)) != 0)
+	{
+		ReorderSlots.SetNumUninitialized(BodyIds.Num());
+		for (int32 Slot = 0; Slot < BodyIds.Num(); ++Slot)
+		{
+			ReorderSlots[Slot] = IdToSlot[State.BodyIds[Slot]];
+		}
+
+		FMemory::Memcpy(BodyIds.GetData(), State.BodyIds.GetData(), BodyIds.Num() * sizeof(int32));
+		for (int32 Slot = 0; Slot < BodyIds.Num(); ++Slot)
+		{
+			IdToSlot[BodyIds[Slot]] = Slot;
+		}
+
+		if (Options.OnBodiesReordered)
+		{
+			Options.OnBodiesReordered(ReorderSlots);
+		}
+	}
+
+	bTimestepLevelsValid = State.TimestepLevels.Num() == GetNumBodies();
+	if (bTimestepLevelsValid)
+	{
+		TimestepLevels.SetNumUninitialized(GetNumBodies(), false);
+		FMemory::Memcpy(TimestepLevels.GetData(), State.TimestepLevels.GetData(), TimestepLevels.Num() * sizeof(int32));
+	}
+
+	// Leapfrog must recompute the accelerations of the restored positions.
+	bAccelerationsValid = false;
+}
+
+template<typename ElementType>
+void FNBodySimSolver::PermuteArray(TArray<ElementType>& Array, TArray<ElementType>& Scratch, TArrayView<const int32> NewToOldSlots)
+{
+	Scratch.SetNumUninitialized(Array.Num(), false);
+	for (int32 Slot = 0; Slot < Array.Num(); ++Slot)
+	{
+		Scratch[Slot] = Array[NewToOldSlots[Slot]];
+	}
+	Swap(Array, Scratch);
+}
+
+void FNBodySimSolver::ReorderBodies()
+{
+	SCOPE_CYCLE_COUNTER(STAT_NBodySimSolver_ReorderBodies);
+
+	const int32 NumBodies = GetNumBodies();
+	if (NumBodies <= 1)
+	{
+		return;
+	}
+
+	// Quantize positions over the screen, which bodies never leave, on the curves' 16 bits grid.
+	const FVector2f HalfScreen(ViewportWidth / 2.0f, ViewportWidth / CameraAspectRatio / 2.0f);
+	const FVector2f GridScale = FVector2f(65535.0f, 65535.0f) / (HalfScreen * 2.0f);
+	const ENBodySimSpaceFillingCurve Curve = Options.ReorderCurve;
+
+	ReorderKeys.SetNumUninitialized(NumBodies, false);
+	ReorderSlots.SetNumUninitialized(NumBodies, false);
+
+	const FVector2f* PositionsData = Positions.GetData();
+	uint32* KeysData = ReorderKeys.GetData();
+	int32* SlotsData = ReorderSlots.GetData();
+
+	ParallelForBodies(NumBodies, [=](int32 Slot)
+	{
+		const FVector2f Cell = (PositionsData[Slot] + HalfScreen) * GridScale;
+		const uint32 CellX = static_cast<uint32>(FMath::Clamp(Cell.X, 0.0f, 65535.0f));
+		const uint32 CellY = static_cast<uint32>(FMath::Clamp(Cell.Y, 0.0f, 65535.0f));
+
+		KeysData[Slot] = (Curve == ENBodySimSpaceFillingCurve::Hilbert) ? FNBodySimHilbert::Encode(CellX, CellY) : FNBodySimMorton::Encode(CellX, CellY);
+		SlotsData[Slot] = Slot;
+	});
+
+	// Stable, so equal keys keep their relative order and the result stays deterministic.
+	FNBodySimRadixSort::Sort(ReorderKeys, ReorderSlots, ReorderTempKeys, ReorderTempSlots);
+
+	// Permute every per body buffer, including the cached accelerations of the leapfrog.
+	PermuteArray(Masses, ReorderScratchFloats, ReorderSlots);
+	PermuteArray(Positions, ReorderScratchVectors, ReorderSlots);
+	PermuteArray(Velocities, ReorderScratchVectors, ReorderSlots);
+	PermuteArray(Accelerations, ReorderScratchVectors, ReorderSlots);
+	PermuteArray(BodyIds, ReorderScratchIds, ReorderSlots);
+
+	if (bTimestepLevelsValid)
+	{
+		PermuteArray(TimestepLevels, ReorderScratchIds, ReorderSlots);
+	}
+
+	for (int32 Slot = 0; Slot < NumBodies; ++Slot)
+	{
+		IdToSlot[BodyIds[Slot]] = Slot;
+	}
+
+	if (Options.OnBodiesReordered)
+	{
+		Options.OnBodiesReordered(ReorderSlots);
+	}
+}
+
+uint32 FNBodySimSolver::ComputeStateHash() const
+{
+	uint32 Hash = FCrc::MemCrc32(Masses.GetData(), Masses.Num() * sizeof(float));
+	Hash = FCrc::MemCrc32(Positions.GetData(), Positions.Num() * sizeof(FVector2f), Hash);
+	Hash = FCrc::MemCrc32(Velocities.GetData(), Velocities.Num() * sizeof(FVector2f), Hash);
+	return Hash;
+}
+
+void FNBodySimSolver::StepSemiImplicitEuler()
+{
+	ComputeAccelerations();
+	Kick(DeltaTime);
+	Drift(DeltaTime);
+}
+
+void FNBodySimSolver::StepLeapfrog()
+{
+	if (!bAccelerationsValid)
+	{
+		ComputeAccelerations();
+	}
+
+	Kick(DeltaTime * 0.5f);
+	Drift(DeltaTime);
+	ComputeAccelerations();
+	Kick(DeltaTime * 0.5f);
+
+	bAccelerationsValid = true;
+}
+
+void FNBodySimSolver::StepBlockTimesteps()
+{
+	// Levels are fractions of a forward DeltaTime.
+	if (DeltaTime <= 0.0f)
+	{
+		return;
+	}
+
+	const int32 NumBodies = GetNumBodies();
+	const int32 NumSubsteps = 1 << Options.MaxTimestepLevel;
+	const float SubstepDuration = DeltaTime / NumSubsteps;
+
+	if (!bAccelerationsValid)
+	{
+		ComputeAccelerations();
+		bAccelerationsValid = true;
+	}
+
+	if (!bTimestepLevelsValid)
+	{
+		// No jerk estimate yet, start from the acceleration criterion alone.
+		TimestepLevels.SetNumUninitialized(NumBodies, false);
+		for (int32 i = 0; i < NumBodies; i++)
+		{
+			TimestepLevels[i] = ComputeTimestepLevel(Accelerations[i], FVector2f::ZeroVector);
+		}
+		bTimestepLevelsValid = true;
+	}
+
+	// Time is counted in substeps. A body of level L steps every NumSubsteps >> L substeps, always starting on a multiple of it.
+	int32 NumEvaluations = 0;
+	int32 Time = 0;
+	while (Time < NumSubsteps)
+	{
+		// Opening half kick of the bodies starting a step, and the next time some body ends its step.
+		int32 NextTime = NumSubsteps;
+		for (int32 i = 0; i < NumBodies; i++)
+		{
+			const int32 Stride = NumSubsteps >> TimestepLevels[i];
+			if (Time % Stride == 0)
+			{
+				Velocities[i] += Accelerations[i] * (Stride * SubstepDuration * 0.5f);
+			}
+			NextTime = FMath::Min(NextTime, (Time / Stride + 1) * Stride);
+		}
+
+		// Every body drifts, forces need all the positions at the same time.
+		Drift((NextTime - Time) * SubstepDuration);
+		Time = NextTime;
+
+		ActiveBodies.Reset();
+		for (int32 i = 0; i < NumBodies; i++)
+		{
+			if (Time % (NumSubsteps >> TimestepLevels[i]) == 0)
+			{
+				ActiveBodies.Add(i);
+			}
+		}
+
+		ActiveAccelerations.SetNumUninitialized(ActiveBodies.Num(), false);
+		ComputeActiveAccelerations(ActiveBodies, ActiveAccelerations);
+		NumEvaluations += ActiveBodies.Num();
+
+		for (int32 ActiveIndex = 0; ActiveIndex < ActiveBodies.Num(); ActiveIndex++)
+		{
+			const int32 Body = ActiveBodies[ActiveIndex];
+			const int32 Level = TimestepLevels[Body];
+			const float StepDuration = (NumSubsteps >> Level) * SubstepDuration;
+			const FVector2f& NewAcceleration = ActiveAccelerations[ActiveIndex];
+
+			// Closing half kick.
+			Velocities[Body] += NewAcceleration * (StepDuration * 0.5f);
+
+			const FVector2f Jerk = (NewAcceleration - Accelerations[Body]) / StepDuration;
+			Accelerations[Body] = NewAcceleration;
+
+			// Finer levels are always in sync. Coarsen one level at a time, and only where the coarser step would start.
+			int32 NewLevel = ComputeTimestepLevel(NewAcceleration, Jerk);
+			if (NewLevel < Level)
+			{
+				NewLevel = (Time % (NumSubsteps >> (Level - 1)) == 0) ? Level - 1 : Level;
+			}
+			TimestepLevels[Body] = NewLevel;
+		}
+	}
+
+	LastStepForceEvaluations = NumEvaluations;
+	UE_LOG(LogNBodySimCore, VeryVerbose, TEXT("Step %llu : %d force evaluations, %d with a shared timestep of the smallest level."), StepCount, NumEvaluations, NumBodies * NumSubsteps);
+}
+
+int32 FNBodySimSolver::ComputeTimestepLevel(const FVector2f& Acceleration, const FVector2f& Jerk) const
+{
+	const float AccelerationSize = Acceleration.Size();
+	const float JerkSize = Jerk.Size();
+
+	// Time to cover the force smoothing distance under Acceleration, and time for Acceleration to change by itself.
+	float Timestep = DeltaTime;
+	if (AccelerationSize > UE_SMALL_NUMBER)
+	{
+		Timestep = FMath::Min(Timestep, FMath::Sqrt(2.0f * Options.TimestepAccuracy * FNBodySimKernels::MinForceDistance / AccelerationSize));
+	}
+	if (JerkSize > UE_SMALL_NUMBER)
+	{
+		Timestep = FMath::Min(Timestep, Options.TimestepAccuracy * AccelerationSize / JerkSize);
+	}
+
+	const int32 Level = Timestep > 0.0f ? FMath::CeilToInt(FMath::Log2(DeltaTime / Timestep)) : Options.MaxTimestepLevel;
+	return FMath::Clamp(Level, 0, Options.MaxTimestepLevel);
+}
+
+void FNBodySimSolver::ComputeAccelerations()
+{
+	const uint32 NumBodies = GetNumBodies();
+	const float* MassesData = Masses.GetData();
+	const FVector2f* PositionsData = Positions.GetData();
+	FVector2f* AccelerationsData = Accelerations.GetData();
+	const float G = GravityConstant;
+
+	// Positions are read only here, accelerations are written to their own buffer.
+	ParallelForBodies(NumBodies, [=](int32 BodyID)
+	{
+		AccelerationsData[BodyID] = FNBodySimKernels::ComputeAcceleration(BodyID, 0, NumBodies, MassesData, PositionsData, G);
+	});
+}
+
+void FNBodySimSolver::ComputeActiveAccelerations(TArrayView<const int32> InActiveBodies, TArrayView<FVector2f> OutAccelerations) const
+{
+	check(InActiveBodies.Num() == OutAccelerations.Num());
+
+	const uint32 NumBodies = GetNumBodies();
+	const int32* ActiveBodiesData = InActiveBodies.GetData();
+	const float* MassesData = Masses.GetData();
+	const FVector2f* PositionsData = Positions.GetData();
+	FVector2f* AccelerationsData = OutAccelerations.GetData();
+	const float G = GravityConstant;
+
+	// Work is spread over the compacted list, so idle bodies cost nothing.
+	ParallelForBodies(InActiveBodies.Num(), [=](int32 ActiveIndex)
+	{
+		AccelerationsData[ActiveIndex] = FNBodySimKernels::ComputeAcceleration(ActiveBodiesData[ActiveIndex], 0, NumBodies, MassesData, PositionsData, G);
+	});
+}
+
+void FNBodySimSolver::Drift(float Duration)
+{
+	FVector2f* PositionsData = Positions.GetData();
+	const FVector2f* VelocitiesData = Velocities.GetData();
+	const float Width = ViewportWidth;
+	const float AspectRatio = CameraAspectRatio;
+
+	// Each body only reads and writes its own position, updating in place gives the same bits whatever the scheduling.
+	ParallelForBodies(Positions.Num(), [=](int32 i)
+	{
+		PositionsData[i] = FNBodySimKernels::WrapPosition(PositionsData[i] + VelocitiesData[i] * Duration, Width, AspectRatio);
+	});
+}
+
+void FNBodySimSolver::Kick(float Duration)
+{
+	FVector2f* VelocitiesData = Velocities.GetData();
+	const FVector2f* AccelerationsData = Accelerations.GetData();
+
+	ParallelForBodies(Velocities.Num(), [=](int32 i)
+	{
+		VelocitiesData[i] += AccelerationsData[i] * Duration;
+	});
+}
+
+void FNBodySimSolver::ParallelForBodies(int32 Num, TFunctionRef<void(int32)> Function) const
+{
+	if (!Options.bDeterministic)
+	{
+		ParallelFor(Num, Function, Options.ParallelForFlags);
+		return;
+	}
+
+	// Fixed chunks, task boundaries only depend on Num and not on the worker count.
+	const int32 NumChunks = FMath::DivideAndRoundUp(Num, DeterministicChunkSize);
+	ParallelFor(NumChunks, [Num, &Function](int32 ChunkIndex)
+	{
+		const int32 ChunkEnd = FMath::Min((ChunkIndex + 1) * DeterministicChunkSize, Num);
+		for (int32 i = ChunkIndex * DeterministicChunkSize; i < ChunkEnd; i++)
+		{
+			Function(i);
+		}
+	}, Options.ParallelForFlags);
+}
@@ -0,0 +1,334 @@
+#include "NBodySimSpatialIndex.h"
+
+#include "Async/ParallelFor.h"
+#include "NBodySimSpaceFillingCurve.h"
+
+DECLARE_STATS_GROUP(TEXT("NBodySimSpatialIndex"), STATGROUP_NBodySimSpatialIndex, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("NBodySimSpatialIndex Update"), STAT_NBodySimSpatialIndex_Update, STATGROUP_NBodySimSpatialIndex);
+
+/** Upper bound of the grid resolution, keeps the cell table at a few megabytes. */
+static constexpr int32 MaxSpatialIndexResolution = 1024;
+
+/** Insertion sort shifts allowed per body and per level of a comparison sort, before falling back to a full sort. */
+static constexpr int32 IncrementalSortShiftBudgetFactor = 2;
+
+FIntPoint FNBodySimSpatialSnapshot::GetCell(const FVector2f& Position) const
+{
+	const FVector2f Local = (Position - Bounds.Min) / CellSize;
+
+	return FIntPoint(
+		FMath::Clamp(FMath::FloorToInt32(Local.X), 0, Resolution - 1),
+		FMath::Clamp(FMath::FloorToInt32(Local.Y), 0, Resolution - 1)
+	);
+}
+
+template<typename VisitorType>
+void FNBodySimSpatialSnapshot::ForEachBodyInCells(const FIntPoint& MinCell, const FIntPoint& MaxCell, VisitorType&& Visitor) const
+{
+	for (int32 CellY = MinCell.Y; CellY <= MaxCell.Y; ++CellY)
+	{
+		for (int32 CellX = MinCell.X; CellX <= MaxCell.X; ++CellX)
+		{
+			const uint32 Code = FNBodySimMorton::Encode(CellX, CellY);
+			for (uint32 SortedIndex = CellStart[Code]; SortedIndex < CellStart[Code + 1]; ++SortedIndex)
+			{
+				Visitor(SortedIndex);
+			}
+		}
+	}
+}
+
+void FNBodySimSpatialSnapshot::QueryBox(const FBox2f& Box, TArray<int32>& OutBodies) const
+{
+	if (GetNumBodies() == 0)
+	{
+		return;
+	}
+
+	ForEachBodyInCells(GetCell(Box.Min), GetCell(Box.Max), [this, &Box, &OutBodies](uint32 SortedIndex)
+	{
+		if (Box.IsInside(SortedPositions[SortedIndex]))
+		{
+			OutBodies.Add(SortedBodies[SortedIndex]);
+		}
+	});
+}
+
+void FNBodySimSpatialSnapshot::QueryRadius(const FVector2f& Center, float Radius, TArray<int32>& OutBodies) const
+{
+	if (GetNumBodies() == 0)
+	{
+		return;
+	}
+
+	const float RadiusSquared = Radius * Radius;
+	const FVector2f Extent(Radius, Radius);
+
+	ForEachBodyInCells(GetCell(Center - Extent), GetCell(Center + Extent), [this, &Center, RadiusSquared, &OutBodies](uint32 SortedIndex)
+	{
+		if (FVector2f::DistSquared(Center, SortedPositions[SortedIndex]) <= RadiusSquared)
+		{
+			OutBodies.Add(SortedBodies[SortedIndex]);
+		}
+	});
+}
+
+void FNBodySimSpatialSnapshot::QueryKNearest(const FVector2f& Center, int32 K, TArray<int32>& OutBodies) const
+{
+	K = FMath::Min(K, GetNumBodies());
+	if (K <= 0)
+	{
+		return;
+	}
+
+	struct FCandidate
+	{
+		float DistanceSquared;
+		int32 Body;
+	};
+
+	// Max heap on distance, its top is the furthest of the K best candidates so far.
+	TArray<FCandidate, TInlineAllocator<32>> Heap;
+	Heap.Reserve(K);
+	auto FurtherFirst = [](const FCandidate& A, const FCandidate& B) { return A.DistanceSquared > B.DistanceSquared; };
+
+	auto Visit = [this, &Center, K, &Heap, &FurtherFirst](uint32 SortedIndex)
+	{
+		const float DistanceSquared = FVector2f::DistSquared(Center, SortedPositions[SortedIndex]);
+		if (Heap.Num() < K)
+		{
+			Heap.HeapPush(FCandidate{ DistanceSquared, SortedBodies[SortedIndex] }, FurtherFirst);
+		}
+		else if (DistanceSquared < Heap.HeapTop().DistanceSquared)
+		{
+			FCandidate Discarded;
+			Heap.HeapPop(Discarded, FurtherFirst, false);
+			Heap.HeapPush(FCandidate{ DistanceSquared, SortedBodies[SortedIndex] }, FurtherFirst);
+		}
+	};
+
+	/**
+	 *	Visit rings of cells of growing Chebyshev distance around the center's cell.
+	 *	Cells of ring R+1 are at least R cells away from the center, so once the K-th candidate
+	 *	is closer than that, no further ring can improve the result.
+	 */
+	const FIntPoint CenterCell = GetCell(Center);
+	const float MinCellSize = FMath::Min(CellSize.X, CellSize.Y);
+
+	for (int32 Ring = 0; Ring < Resolution; ++Ring)
+	{
+		const FIntPoint MinCell(CenterCell.X - Ring, CenterCell.Y - Ring);
+		const FIntPoint MaxCell(CenterCell.X + Ring, CenterCell.Y + Ring);
+
+		for (int32 CellY = FMath::Max(MinCell.Y, 0); CellY <= FMath::Min(MaxCell.Y, Resolution - 1); ++CellY)
+		{
+			// Inner cells were visited by the previous rings, only the border of the ring is new.
+			const bool bBorderRow = (CellY == MinCell.Y || CellY == MaxCell.Y);
+			const int32 StepX = bBorderRow ? 1 : FMath::Max(MaxCell.X - MinCell.X, 1);
+
+			for (int32 CellX = MinCell.X; CellX <= MaxCell.X; CellX += StepX)
+			{
+				if (CellX >= 0 && CellX < Resolution)
+				{
+					ForEachBodyInCells(FIntPoint(CellX, CellY), FIntPoint(CellX, CellY), Visit);
+				}
+			}
+		}
+
+		const float UnvisitedDistance = Ring * MinCellSize;
+		if (Heap.Num() == K && Heap.HeapTop().DistanceSquared <= UnvisitedDistance * UnvisitedDistance)
+		{
+			break;
+		}
+	}
+
+	// Pop from the furthest to the nearest, then write them nearest first.
+	const int32 FirstOutput = OutBodies.AddUninitialized(Heap.Num());
+	for (int32 i = Heap.Num() - 1; i >= 0; --i)
+	{
+		FCandidate Candidate;
+		Heap.HeapPop(Candidate, FurtherFirst, false);
+		OutBodies[FirstOutput + i] = Candidate.Body;
+	}
+}
+
+
+FNBodySimSpatialIndex::FNBodySimSpatialIndex(int32 InTargetBodiesPerCell)
+	: TargetBodiesPerCell(FMath::Max(InTargetBodiesPerCell, 1))
+{
+}
+
+void FNBodySimSpatialIndex::Update(TArrayView<const FVector2f> Positions, const FBox2f& Bounds, TArrayView<const int32> BodyIds)
+{
+	check(BodyIds.Num() == 0 || BodyIds.Num() == Positions.Num());
+
+	SCOPE_CYCLE_COUNTER(STAT_NBodySimSpatialIndex_Update);
+
+	const int32 NumBodies = Positions.Num();
+	const int32 Resolution = ComputeResolution(NumBodies);
+
+	TSharedPtr<FNBodySimSpatialSnapshot, ESPMode::ThreadSafe> Snapshot = AcquireSnapshotToBuild();
+	Snapshot->Version = ++Version;
+	Snapshot->Bounds = Bounds;
+	Snapshot->Resolution = Resolution;
+	Snapshot->CellSize = Bounds.GetSize() / static_cast<float>(Resolution);
+
+	// Entries of the last update are only reusable on the same grid and the same bodies.
+	const bool bIncremental = SortedEntries.Num() == NumBodies && Resolution == LastResolution && Bounds == LastBounds;
+	if (!bIncremental)
+	{
+		SortedEntries.SetNumUninitialized(NumBodies);
+		for (int32 Body = 0; Body < NumBodies; ++Body)
+		{
+			SortedEntries[Body] = Body;
+		}
+		LastResolution = Resolution;
+		LastBounds = Bounds;
+	}
+
+	// Re-key every body in the previous order.
+	for (uint64& Entry : SortedEntries)
+	{
+		const uint32 Body = static_cast<uint32>(Entry);
+		const FIntPoint Cell = Snapshot->GetCell(Positions[Body]);
+
+		Entry = (static_cast<uint64>(FNBodySimMorton::Encode(Cell.X, Cell.Y)) << 32) | Body;
+	}
+
+	bool bSorted = bIncremental;
+	if (bIncremental)
+	{
+		/**
+		 *	Nearly sorted, insertion sort costs one shift per pair of entries out of order, however few bodies moved.
+		 *	A single body crossing the grid can cost N shifts, so give up once the shifts reach the O(N log N)
+		 *	of a full sort. Entries stay a permutation of the keys, the full sort takes over from there.
+		 */
+		const int64 ShiftBudget = static_cast<int64>(IncrementalSortShiftBudgetFactor) * NumBodies * (FMath::FloorLog2(FMath::Max(NumBodies, 1)) + 1);
+		int64 NumShifts = 0;
+
+		for (int32 i = 1; i < NumBodies && bSorted; ++i)
+		{
+			const uint64 Entry = SortedEntries[i];
+			int32 j = i - 1;
+			for (; j >= 0 && SortedEntries[j] > Entry; --j)
+			{
+				SortedEntries[j + 1] = SortedEntries[j];
+			}
+			SortedEntries[j + 1] = Entry;
+
+			NumShifts += i - 1 - j;
+			bSorted = NumShifts <= ShiftBudget;
+		}
+	}
+
+	if (!bSorted)
+	{
+		SortedEntries.Sort();
+	}
+
+	// Fill the snapshot from the sorted entries.
+	const int32 NumCells = Resolution * Resolution;
+	Snapshot->CellStart.SetNumUninitialized(NumCells + 1, false);
+	FMemory::Memzero(Snapshot->CellStart.GetData(), Snapshot->CellStart.Num() * sizeof(uint32));
+	Snapshot->SortedBodies.SetNumUninitialized(NumBodies, false);
+	Snapshot->SortedPositions.SetNumUninitialized(NumBodies, false);
+
+	for (int32 i = 0; i < NumBodies; ++i)
+	{
+		const uint32 Body = static_cast<uint32>(SortedEntries[i]);
+		const uint32 Code = static_cast<uint32>(SortedEntries[i] >> 32);
+
+		Snapshot->SortedBodies[i] = BodyIds.Num() > 0 ? BodyIds[Body] : Body;
+		Snapshot->SortedPositions[i] = Positions[Body];
+		++Snapshot->CellStart[Code + 1];
+	}
+
+	for (int32 Cell = 0; Cell < NumCells; ++Cell)
+	{
+		Snapshot->CellStart[Cell + 1] += Snapshot->CellStart[Cell];
+	}
+
+	// Publish, readers holding the current snapshot keep it alive until they are done.
+	FRWScopeLock Lock(SnapshotLock, SLT_Write);
+	PreviousSnapshot = MoveTemp(CurrentSnapshot);
+	CurrentSnapshot = MoveTemp(Snapshot);
+}
+
+FNBodySimSpatialSnapshotPtr FNBodySimSpatialIndex::GetSnapshot() const
+{
+	FRWScopeLock Lock(SnapshotLock, SLT_ReadOnly);
+	return CurrentSnapshot;
+}
+
+void FNBodySimSpatialIndex::QueryBoxBatch(TArrayView<const FBox2f> Boxes, TArray<TArray<int32>>& OutResults) const
+{
+	FNBodySimSpatialSnapshotPtr Snapshot = GetSnapshot();
+
+	OutResults.SetNum(Boxes.Num());
+	if (!Snapshot)
+	{
+		return;
+	}
+
+	ParallelFor(Boxes.Num(), [&Snapshot, &Boxes, &OutResults](int32 QueryIndex)
+	{
+		OutResults[QueryIndex].Reset();
+		Snapshot->QueryBox(Boxes[QueryIndex], OutResults[QueryIndex]);
+	});
+}
+
+void FNBodySimSpatialIndex::QueryRadiusBatch(TArrayView<const FVector2f> Centers, float Radius, TArray<TArray<int32>>& OutResults) const
+{
+	FNBodySimSpatialSnapshotPtr Snapshot = GetSnapshot();
+
+	OutResults.SetNum(Centers.Num());
+	if (!Snapshot)
+	{
+		return;
+	}
+
+	ParallelFor(Centers.Num(), [&Snapshot, &Centers, Radius, &OutResults](int32 QueryIndex)
+	{
+		OutResults[QueryIndex].Reset();
+		Snapshot->QueryRadius(Centers[QueryIndex], Radius, OutResults[QueryIndex]);
+	});
+}
+
+void FNBodySimSpatialIndex::QueryKNearestBatch(TArrayView<const FVector2f> Centers, int32 K, TArray<TArray<int32>>& OutResults) const
+{
+	FNBodySimSpatialSnapshotPtr Snapshot = GetSnapshot();
+
+	OutResults.SetNum(Centers.Num());
+	if (!Snapshot)
+	{
+		return;
+	}
+
+	ParallelFor(Centers.Num(), [&Snapshot, &Centers, K, &OutResults](int32 QueryIndex)
+	{
+		OutResults[QueryIndex].Reset();
+		Snapshot->QueryKNearest(Centers[QueryIndex], K, OutResults[QueryIndex]);
+	});
+}
+
+int32 FNBodySimSpatialIndex::ComputeResolution(int32 NumBodies) const
+{
+	const int32 TargetCells = FMath::Max(NumBodies / TargetBodiesPerCell, 1);
+	const int32 Resolution = FMath::RoundUpToPowerOfTwo(FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(TargetCells))));
+
+	return FMath::Clamp(Resolution, 1, MaxSpatialIndexResolution);
+}
+
+TSharedPtr<FNBodySimSpatialSnapshot, ESPMode::ThreadSafe> FNBodySimSpatialIndex::AcquireSnapshotToBuild()
+{
+	/**
+	 *	Readers only ever get the current snapshot, so once nobody else references the previous
+	 *	one it can safely be refilled instead of allocating a new one.
+	 */
+	if (PreviousSnapshot.IsValid() && PreviousSnapshot.IsUnique())
+	{
+		return MoveTemp(PreviousSnapshot);
+	}
+
+	return MakeShared<FNBodySimSpatialSnapshot, ESPMode::ThreadSafe>();
+}
@@ -0,0 +1,283 @@
+#include "Algo/AnyOf.h"
+#include "Misc/AutomationTest.h"
+#include "NBodySimRadixSort.h"
+#include "NBodySimSolver.h"
+#include "NBodySimSpaceFillingCurve.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace NBodySimReorderTests
+{
+	static constexpr uint32 TestFlags = EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter;
+
+	/** Radix sort Keys with their index as value, and compare with a stable sort of the same pairs. */
+	static void TestRadixSort(FAutomationTestBase& Test, const FString& What, const TArray<uint32>& InKeys, TArray<uint32>& TempKeys, TArray<int32>& TempValues)
+	{
+		TArray<TPair<uint32, int32>> Expected;
+		TArray<uint32> Keys = InKeys;
+		TArray<int32> Values;
+		for (int32 i = 0; i < Keys.Num(); i++)
+		{
+			Expected.Emplace(Keys[i], i);
+			Values.Add(i);
+		}
+		Expected.StableSort([](const TPair<uint32, int32>& A, const TPair<uint32, int32>& B) { return A.Key < B.Key; });
+
+		FNBodySimRadixSort::Sort(Keys, Values, TempKeys, TempValues);
+
+		if (!Test.TestEqual(FString::Printf(TEXT("%s count"), *What), Keys.Num(), Expected.Num()) || !Test.TestEqual(FString::Printf(TEXT("%s value count"), *What), Values.Num(), Expected.Num()))
+		{
+			return;
+		}
+
+		for (int32 i = 0; i < Expected.Num(); i++)
+		{
+			if (Keys[i] != Expected[i].Key || Values[i] != Expected[i].Value)
+			{
+				Test.AddError(FString::Printf(TEXT("%s : element %d is (%08x, %d), expected (%08x, %d)."), *What, i, Keys[i], Values[i], Expected[i].Key, Expected[i].Value));
+				return;
+			}
+		}
+	}
+
+	static FNBodySimParameters MakeParameters(int32 NumBodies)
+	{
+		FRandomStream Random(17);
+
+		FNBodySimParameters Parameters;
+		Parameters.GravityConstant = 1000.0f;
+		Parameters.ViewportWidth = 8000.0f;
+		Parameters.CameraAspectRatio = 1.777778f;
+		Parameters.DeltaTime = 1.0f / 60.0f;
+
+		for (int32 i = 0; i < NumBodies; i++)
+		{
+			const float Mass = Random.FRandRange(20.0f, 50.0f);
+			const float X = Random.FRandRange(-4000.0f, 4000.0f);
+			const float Y = Random.FRandRange(-2250.0f, 2250.0f);
+			const float VelocityX = Random.FRandRange(-300.0f, 300.0f);
+			const float VelocityY = Random.FRandRange(-300.0f, 300.0f);
+			Parameters.Bodies.Emplace(Mass, FVector2f(X, Y), FVector2f(VelocityX, VelocityY));
+		}
+		Parameters.NumBodies = Parameters.Bodies.Num();
+		return Parameters;
+	}
+
+	/** Every slot holds the body whose id maps back to it, and every id is used once. */
+	static void TestSlotsConsistent(FAutomationTestBase& Test, const FString& What, const FNBodySimSolver& Solver)
+	{
+		TArray<bool> IdSeen;
+		IdSeen.SetNumZeroed(Solver.GetNumBodies());
+
+		TArrayView<const int32> BodyIds = Solver.GetBodyIds();
+		for (int32 Slot = 0; Slot < BodyIds.Num(); Slot++)
+		{
+			const int32 Id = BodyIds[Slot];
+			if (!IdSeen.IsValidIndex(Id) || IdSeen[Id] || Solver.GetBodySlot(Id) != Slot)
+			{
+				Test.AddError(FString::Printf(TEXT("%s : slot %d holds body %d, which is out of range, duplicated or maps to another slot."), *What, Slot, Id));
+				return;
+			}
+			IdSeen[Id] = true;
+		}
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimReorderRadixSortTest, "NBodySim.Reorder.RadixSort", NBodySimReorderTests::TestFlags)
+
+bool FNBodySimReorderRadixSortTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimReorderTests;
+
+	FRandomStream Random(23);
+
+	// Scratch buffers are shared by every case, as the solver keeps them between reorders.
+	TArray<uint32> TempKeys;
+	TArray<int32> TempValues;
+
+	TestRadixSort(*this, TEXT("Empty"), {}, TempKeys, TempValues);
+	TestRadixSort(*this, TEXT("Single key"), { 42 }, TempKeys, TempValues);
+
+	// Several chunks of 4096 keys and a partial one, half of the keys drawn from a few values so many are duplicated.
+	TArray<uint32> Keys;
+	for (int32 i = 0; i < 3 * 4096 + 123; i++)
+	{
+		Keys.Add(Random.RandHelper(2) ? static_cast<uint32>(Random.RandHelper(8)) * 0x01010101u : Random.GetUnsignedInt());
+	}
+	TestRadixSort(*this, TEXT("Full range"), Keys, TempKeys, TempValues);
+
+	// Only some of the 4 digit passes run, leaving the results after an odd or even number of swaps.
+	const struct { const TCHAR* Name; uint32 Mask; uint32 Shift; } SkippedPasses[] =
+	{
+		{ TEXT("Low digit only, 1 pass"), 0xFFu, 0 },
+		{ TEXT("Low 3 digits, 3 passes"), 0xFFFFFFu, 0 },
+		{ TEXT("High digit only, 1 pass"), 0xFFu, 24 },
+		{ TEXT("Middle 2 digits, 2 passes"), 0xFFFFu, 8 },
+	};
+	for (const auto& Case : SkippedPasses)
+	{
+		Keys.Reset();
+		for (int32 i = 0; i < 2 * 4096 + 7; i++)
+		{
+			Keys.Add((Random.GetUnsignedInt() & Case.Mask) << Case.Shift);
+		}
+		TestRadixSort(*this, Case.Name, Keys, TempKeys, TempValues);
+	}
+
+	// No pass at all, values keep their order.
+	Keys.Init(0xABCDEF01u, 5000);
+	TestRadixSort(*this, TEXT("All keys equal"), Keys, TempKeys, TempValues);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimReorderHilbertCurveTest, "NBodySim.Reorder.HilbertCurve", NBodySimReorderTests::TestFlags)
+
+bool FNBodySimReorderHilbertCurveTest::RunTest(const FString& Parameters)
+{
+	// The corner 16 x 16 cells of the grid are the first 256 codes of the curve.
+	const uint32 Size = 16;
+
+	TArray<FIntPoint> CellOfCode;
+	CellOfCode.Init(FIntPoint(INDEX_NONE, INDEX_NONE), Size * Size);
+
+	for (uint32 X = 0; X < Size; X++)
+	{
+		for (uint32 Y = 0; Y < Size; Y++)
+		{
+			const uint32 Code = FNBodySimHilbert::Encode(X, Y);
+			if (!TestTrue(FString::Printf(TEXT("Code %u of cell (%u, %u) in range"), Code, X, Y), Code < Size * Size))
+			{
+				return false;
+			}
+			if (!TestEqual(FString::Printf(TEXT("Code %u used once"), Code), CellOfCode[Code], FIntPoint(INDEX_NONE, INDEX_NONE)))
+			{
+				return false;
+			}
+			CellOfCode[Code] = FIntPoint(X, Y);
+		}
+	}
+
+	// Every cell has a code, and consecutive codes are side by side.
+	for (uint32 Code = 0; Code + 1 < Size * Size; Code++)
+	{
+		const FIntPoint Delta = CellOfCode[Code + 1] - CellOfCode[Code];
+		TestEqual(FString::Printf(TEXT("Codes %u and %u are neighbor cells"), Code, Code + 1), FMath::Abs(Delta.X) + FMath::Abs(Delta.Y), 1);
+	}
+
+	// The full curve starts and ends on the bottom corners.
+	TestEqual(TEXT("First cell"), FNBodySimHilbert::Encode(0, 0), 0u);
+	TestEqual(TEXT("Last cell"), FNBodySimHilbert::Encode(FNBodySimHilbert::GridSize - 1, 0), MAX_uint32);
+
+	// Morton codes round trip.
+	for (uint32 X : { 0u, 1u, 1234u, 65535u })
+	{
+		for (uint32 Y : { 0u, 7u, 40000u, 65535u })
+		{
+			uint32 DecodedX = 0;
+			uint32 DecodedY = 0;
+			FNBodySimMorton::Decode(FNBodySimMorton::Encode(X, Y), DecodedX, DecodedY);
+			TestEqual(FString::Printf(TEXT("Morton (%u, %u)"), X, Y), FIntPoint(DecodedX, DecodedY), FIntPoint(X, Y));
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimReorderSolverTest, "NBodySim.Reorder.Solver", NBodySimReorderTests::TestFlags)
+
+bool FNBodySimReorderSolverTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimReorderTests;
+
+	const int32 NumSteps = 60;
+	const FNBodySimParameters SimParameters = MakeParameters(800);
+
+	TUniquePtr<FNBodySimSolver> Reference = FNBodySimSolver::Create(SimParameters);
+	if (!TestNotNull(TEXT("Reference solver"), Reference.Get()))
+	{
+		return false;
+	}
+	Reference->Step(NumSteps);
+
+	for (ENBodySimSpaceFillingCurve Curve : { ENBodySimSpaceFillingCurve::Morton, ENBodySimSpaceFillingCurve::Hilbert })
+	{
+		const FString CurveName = Curve == ENBodySimSpaceFillingCurve::Morton ? TEXT("Morton") : TEXT("Hilbert");
+
+		// Follow the moves the way the simulation engine does for its instances.
+		TArray<int32> ObservedIds;
+		for (int32 Id = 0; Id < SimParameters.Bodies.Num(); Id++)
+		{
+			ObservedIds.Add(Id);
+		}
+
+		FNBodySimSolverOptions Options;
+		Options.ReorderInterval = 7;
+		Options.ReorderCurve = Curve;
+		Options.OnBodiesReordered = [&ObservedIds](TArrayView<const int32> NewToOldSlots)
+		{
+			TArray<int32> PreviousIds = ObservedIds;
+			for (int32 Slot = 0; Slot < NewToOldSlots.Num(); Slot++)
+			{
+				ObservedIds[Slot] = PreviousIds[NewToOldSlots[Slot]];
+			}
+		};
+
+		TUniquePtr<FNBodySimSolver> Solver = FNBodySimSolver::Create(SimParameters, Options);
+		if (!TestNotNull(TEXT("Solver"), Solver.Get()))
+		{
+			return false;
+		}
+		Solver->Step(NumSteps);
+
+		TestSlotsConsistent(*this, CurveName, *Solver);
+		TestEqual(FString::Printf(TEXT("%s observer follows the moves"), *CurveName), TArray<int32>(Solver->GetBodyIds()), ObservedIds);
+		TestTrue(FString::Printf(TEXT("%s bodies moved in memory"), *CurveName), Algo::AnyOf(ObservedIds, [Slot = 0](int32 Id) mutable { return Id != Slot++; }));
+
+		// Forces are summed in another order, compare up to float rounding, across the screen edges.
+		const FVector2f ScreenSize(SimParameters.ViewportWidth, SimParameters.ViewportWidth / SimParameters.CameraAspectRatio);
+		float MaxPositionError = 0.0f;
+		float MaxVelocityError = 0.0f;
+		for (int32 Id = 0; Id < SimParameters.Bodies.Num(); Id++)
+		{
+			const int32 Slot = Solver->GetBodySlot(Id);
+			const int32 ReferenceSlot = Reference->GetBodySlot(Id);
+			const FVector2f PositionDelta = Solver->GetPositions()[Slot] - Reference->GetPositions()[ReferenceSlot];
+			const FVector2f WrappedDelta(
+				FMath::Min(FMath::Abs(PositionDelta.X), ScreenSize.X - FMath::Abs(PositionDelta.X)),
+				FMath::Min(FMath::Abs(PositionDelta.Y), ScreenSize.Y - FMath::Abs(PositionDelta.Y)));
+
+			MaxPositionError = FMath::Max(MaxPositionError, WrappedDelta.Size());
+			MaxVelocityError = FMath::Max(MaxVelocityError, (Solver->GetVelocities()[Slot] - Reference->GetVelocities()[ReferenceSlot]).Size());
+
+			if (Solver->GetMasses()[Slot] != Reference->GetMasses()[ReferenceSlot])
+			{
+				AddError(FString::Printf(TEXT("%s : body %d has mass %f, expected %f."), *CurveName, Id, Solver->GetMasses()[Slot], Reference->GetMasses()[ReferenceSlot]));
+			}
+		}
+		TestTrue(FString::Printf(TEXT("%s position error %f under 0.05"), *CurveName, MaxPositionError), MaxPositionError < 0.05f);
+		TestTrue(FString::Printf(TEXT("%s velocity error %f under 0.05"), *CurveName, MaxVelocityError), MaxVelocityError < 0.05f);
+
+		// Right after a reorder, slots follow the curve.
+		Solver->ReorderBodies();
+		TestSlotsConsistent(*this, FString::Printf(TEXT("%s after ReorderBodies"), *CurveName), *Solver);
+
+		const FVector2f GridScale = FVector2f(65535.0f, 65535.0f) / ScreenSize;
+		uint32 PreviousKey = 0;
+		for (int32 Slot = 0; Slot < Solver->GetNumBodies(); Slot++)
+		{
+			const FVector2f Cell = (Solver->GetPositions()[Slot] + ScreenSize * 0.5f) * GridScale;
+			const uint32 CellX = static_cast<uint32>(FMath::Clamp(Cell.X, 0.0f, 65535.0f));
+			const uint32 CellY = static_cast<uint32>(FMath::Clamp(Cell.Y, 0.0f, 65535.0f));
+			const uint32 Key = Curve == ENBodySimSpaceFillingCurve::Hilbert ? FNBodySimHilbert::Encode(CellX, CellY) : FNBodySimMorton::Encode(CellX, CellY);
+
+			if (Key < PreviousKey)
+			{
+				AddError(FString::Printf(TEXT("%s : slot %d key %08x is before the previous one %08x."), *CurveName, Slot, Key, PreviousKey));
+				break;
+			}
+			PreviousKey = Key;
+		}
+	}
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,81 @@
+#include "Misc/AutomationTest.h"
+#include "NBodySimReplay.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace NBodySimReplayTests
+{
+	static constexpr uint32 TestFlags = EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter;
+
+	/** Deterministic leapfrog solver over a fixed set of random bodies, as the simulation engine creates it for a replay. */
+	static TUniquePtr<FNBodySimSolver> CreateSolver()
+	{
+		FRandomStream Random(7);
+
+		FNBodySimParameters Parameters;
+		Parameters.GravityConstant = 1000.0f;
+		Parameters.ViewportWidth = 8000.0f;
+		Parameters.CameraAspectRatio = 1.777778f;
+		Parameters.DeltaTime = 1.0f / 60.0f;
+
+		for (int32 i = 0; i < 300; i++)
+		{
+			const float Mass = Random.FRandRange(20.0f, 50.0f);
+			const float X = Random.FRandRange(-1000.0f, 1000.0f);
+			const float Y = Random.FRandRange(-1000.0f, 1000.0f);
+			Parameters.Bodies.Emplace(Mass, FVector2f(X, Y), FVector2f::ZeroVector);
+		}
+		Parameters.NumBodies = Parameters.Bodies.Num();
+
+		FNBodySimSolverOptions Options;
+		Options.Integrator = ENBodySimIntegrator::Leapfrog;
+		Options.bDeterministic = true;
+		return FNBodySimSolver::Create(Parameters, Options);
+	}
+
+	/** State hash of a solver stepped straight forward to Step. */
+	static uint32 ComputeForwardStateHash(uint64 Step)
+	{
+		TUniquePtr<FNBodySimSolver> Solver = CreateSolver();
+		Solver->Step(static_cast<int32>(Step));
+		return Solver->ComputeStateHash();
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimReplayStepAfterBackwardTest, "NBodySim.Replay.StepAfterBackward", NBodySimReplayTests::TestFlags)
+
+bool FNBodySimReplayStepAfterBackwardTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimReplayTests;
+
+	TUniquePtr<FNBodySimSolver> Solver = CreateSolver();
+	if (!TestNotNull(TEXT("Solver"), Solver.Get()))
+	{
+		return false;
+	}
+
+	FNBodySimReplay Replay(*Solver, 10, 64 * 1024 * 1024);
+
+	Replay.Step(50);
+	TestEqual(TEXT("Latest step"), Replay.GetLatestStep(), static_cast<uint64>(50));
+
+	// Leapfrog reversibility, only exact up to float rounding.
+	TestTrue(TEXT("Step backward"), Replay.StepBackward(15));
+	TestEqual(TEXT("Current step after stepping backward"), Replay.GetCurrentStep(), static_cast<uint64>(35));
+
+	// Play past the furthest recorded step, capturing new keyframes on the way.
+	Replay.Step(30);
+	TestEqual(TEXT("Latest step"), Replay.GetLatestStep(), static_cast<uint64>(65));
+	TestEqual(TEXT("State hash after playing past the latest step"), Solver->ComputeStateHash(), ComputeForwardStateHash(65));
+
+	// Keyframes captured after stepping backward are exact as well.
+	TestTrue(TEXT("Seek"), Replay.Seek(60));
+	TestEqual(TEXT("State hash at a keyframe captured after stepping backward"), Solver->ComputeStateHash(), ComputeForwardStateHash(60));
+
+	// Seeking back and forth lands on the same states as a straight run.
+	TestTrue(TEXT("Seek"), Replay.Seek(23));
+	TestEqual(TEXT("State hash after seeking backward"), Solver->ComputeStateHash(), ComputeForwardStateHash(23));
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,587 @@
+#include "Algo/AnyOf.h"
+#include "Misc/AutomationTest.h"
+#include "NBodySimKernels.h"
+#include "NBodySimSolver.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace NBodySimSolverTests
+{
+	static constexpr uint32 TestFlags = EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter;
+
+	static FNBodySimParameters MakeParameters(TArray<FBodyData> Bodies, float GravityConstant, float ViewportWidth, float CameraAspectRatio, float DeltaTime)
+	{
+		FNBodySimParameters Parameters;
+		Parameters.Bodies = MoveTemp(Bodies);
+		Parameters.NumBodies = Parameters.Bodies.Num();
+		Parameters.GravityConstant = GravityConstant;
+		Parameters.ViewportWidth = ViewportWidth;
+		Parameters.CameraAspectRatio = CameraAspectRatio;
+		Parameters.DeltaTime = DeltaTime;
+		return Parameters;
+	}
+
+	/** Kinetic plus potential energy, valid while every pair is further apart than the force smoothing distance. */
+	static double ComputeEnergy(const FNBodySimSolver& Solver)
+	{
+		TArrayView<const float> Masses = Solver.GetMasses();
+		TArrayView<const FVector2f> Positions = Solver.GetPositions();
+		TArrayView<const FVector2f> Velocities = Solver.GetVelocities();
+
+		double Energy = 0.0;
+		for (int32 i = 0; i < Masses.Num(); i++)
+		{
+			Energy += 0.5 * Masses[i] * Velocities[i].SizeSquared();
+			for (int32 j = i + 1; j < Masses.Num(); j++)
+			{
+				Energy -= static_cast<double>(Solver.GetGravityConstant()) * Masses[i] * Masses[j] / (Positions[j] - Positions[i]).Size();
+			}
+		}
+		return Energy;
+	}
+
+	/** Two bodies of the same mass on a circular orbit around their center of mass at the origin. */
+	static TArray<FBodyData> MakeCircularOrbit(float Mass, float Separation, float GravityConstant)
+	{
+		// Each body turns at Separation / 2 from the center, pulled by G * Mass / Separation^2.
+		const float Speed = FMath::Sqrt(GravityConstant * Mass * 0.5f / Separation);
+
+		TArray<FBodyData> Bodies;
+		Bodies.Emplace(Mass, FVector2f(-Separation * 0.5f, 0.0f), FVector2f(0.0f, -Speed));
+		Bodies.Emplace(Mass, FVector2f(Separation * 0.5f, 0.0f), FVector2f(0.0f, Speed));
+		return Bodies;
+	}
+
+	static TArray<FBodyData> MakeRandomBodies(int32 NumBodies, float Extent, float MaxSpeed, int32 Seed)
+	{
+		FRandomStream Random(Seed);
+
+		TArray<FBodyData> Bodies;
+		for (int32 i = 0; i < NumBodies; i++)
+		{
+			// Drawn one by one, argument evaluation order is unspecified.
+			const float Mass = Random.FRandRange(100.0f, 1000.0f);
+			const float X = Random.FRandRange(-Extent, Extent);
+			const float Y = Random.FRandRange(-Extent, Extent);
+			const float VelocityX = Random.FRandRange(-MaxSpeed, MaxSpeed);
+			const float VelocityY = Random.FRandRange(-MaxSpeed, MaxSpeed);
+
+			Bodies.Emplace(Mass, FVector2f(X, Y), FVector2f(VelocityX, VelocityY));
+		}
+		return Bodies;
+	}
+
+	/** A tight heavy pair at the origin, and light bodies far enough to barely perturb it. */
+	static TArray<FBodyData> MakeHeavyPairWithLightBodies(int32 NumLightBodies, float GravityConstant, int32 Seed)
+	{
+		TArray<FBodyData> Bodies = MakeCircularOrbit(10000.0f, 200.0f, GravityConstant);
+
+		FRandomStream Random(Seed);
+		for (int32 i = 0; i < NumLightBodies; i++)
+		{
+			const float Angle = Random.FRandRange(0.0f, 2.0f * PI);
+			const float Radius = Random.FRandRange(3000.0f, 6000.0f);
+			const float VelocityX = Random.FRandRange(-20.0f, 20.0f);
+			const float VelocityY = Random.FRandRange(-20.0f, 20.0f);
+
+			Bodies.Emplace(1.0f, FVector2f(FMath::Cos(Angle), FMath::Sin(Angle)) * Radius, FVector2f(VelocityX, VelocityY));
+		}
+		return Bodies;
+	}
+
+	/** Masses, positions and velocities of the bodies of Solver, in id order. */
+	static TArray<FBodyData> GetBodiesById(const FNBodySimSolver& Solver)
+	{
+		TArray<FBodyData> Bodies;
+		for (int32 Id = 0; Id < Solver.GetNumBodies(); Id++)
+		{
+			const int32 Slot = Solver.GetBodySlot(Id);
+			Bodies.Emplace(Solver.GetMasses()[Slot], Solver.GetPositions()[Slot], Solver.GetVelocities()[Slot]);
+		}
+		return Bodies;
+	}
+
+	/** Every id maps to the slot holding it, so ids and slots are a bijection. */
+	static void TestBodySlots(FAutomationTestBase& Test, const FString& What, const FNBodySimSolver& Solver)
+	{
+		TArrayView<const int32> BodyIds = Solver.GetBodyIds();
+		if (!Test.TestEqual(What + TEXT(" id count"), BodyIds.Num(), Solver.GetNumBodies()))
+		{
+			return;
+		}
+
+		for (int32 Id = 0; Id < Solver.GetNumBodies(); Id++)
+		{
+			const int32 Slot = Solver.GetBodySlot(Id);
+			if (!BodyIds.IsValidIndex(Slot) || BodyIds[Slot] != Id)
+			{
+				Test.AddError(FString::Printf(TEXT("%s : body %d is in slot %d, holding body %d."), *What, Id, Slot, BodyIds.IsValidIndex(Slot) ? BodyIds[Slot] : INDEX_NONE));
+				return;
+			}
+		}
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimSolverSemiImplicitEulerTest, "NBodySim.Solver.SemiImplicitEuler", NBodySimSolverTests::TestFlags)
+
+bool FNBodySimSolverSemiImplicitEulerTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimSolverTests;
+
+	const float G = 10.0f;
+	const float DeltaTime = 0.5f;
+
+	TArray<FBodyData> Bodies;
+	Bodies.Emplace(1000.0f, FVector2f(0.0f, 0.0f), FVector2f(1.0f, 2.0f));
+	Bodies.Emplace(2000.0f, FVector2f(300.0f, 0.0f), FVector2f(0.0f, -1.0f));
+	Bodies.Emplace(500.0f, FVector2f(0.0f, 50.0f), FVector2f(0.0f, 0.0f));
+
+	TUniquePtr<FNBodySimSolver> Solver = FNBodySimSolver::Create(MakeParameters(Bodies, G, 10000.0f, 1.0f, DeltaTime));
+	if (!TestNotNull(TEXT("Solver"), Solver.Get()))
+	{
+		return false;
+	}
+
+	Solver->Step();
+
+	// Kick with the forces of the initial positions, then drift with the new velocities.
+	for (int32 i = 0; i < Bodies.Num(); i++)
+	{
+		FVector2f Acceleration = FVector2f::ZeroVector;
+		for (int32 j = 0; j < Bodies.Num(); j++)
+		{
+			if (j != i)
+			{
+				Acceleration += FNBodySimKernels::ComputePairAcceleration(Bodies[i].Position, Bodies[j].Position, Bodies[j].Mass, G);
+			}
+		}
+
+		const FVector2f Velocity = Bodies[i].Velocity + Acceleration * DeltaTime;
+		const FVector2f Position = Bodies[i].Position + Velocity * DeltaTime;
+
+		TestTrue(FString::Printf(TEXT("Velocity of body %d"), i), Solver->GetVelocities()[i].Equals(Velocity, 1e-5f));
+		TestTrue(FString::Printf(TEXT("Position of body %d"), i), Solver->GetPositions()[i].Equals(Position, 1e-4f));
+	}
+
+	// Body 0 by hand: G * 2000 / 300^2 along +X, and 500 closer than the smoothing distance, G * 500 / 100^2 along +Y.
+	const FVector2f Acceleration0(G * 2000.0f / (300.0f * 300.0f), G * 500.0f / (100.0f * 100.0f));
+	TestTrue(TEXT("Velocity of body 0 by hand"), Solver->GetVelocities()[0].Equals(FVector2f(1.0f, 2.0f) + Acceleration0 * DeltaTime, 1e-5f));
+
+	TestEqual(TEXT("Step count"), Solver->GetStepCount(), static_cast<uint64>(1));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimSolverWrappingTest, "NBodySim.Solver.Wrapping", NBodySimSolverTests::TestFlags)
+
+bool FNBodySimSolverWrappingTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimSolverTests;
+
+	// A 1000 x 500 screen centered on the origin.
+	TArray<FBodyData> Bodies;
+	Bodies.Emplace(1.0f, FVector2f(490.0f, 0.0f), FVector2f(40.0f, 0.0f));
+	Bodies.Emplace(1.0f, FVector2f(-490.0f, 200.0f), FVector2f(-30.0f, 0.0f));
+	Bodies.Emplace(1.0f, FVector2f(-200.0f, -240.0f), FVector2f(0.0f, -20.0f));
+	Bodies.Emplace(1.0f, FVector2f(200.0f, 245.0f), FVector2f(0.0f, 10.0f));
+
+	// No gravity, bodies move in straight lines.
+	TUniquePtr<FNBodySimSolver> Solver = FNBodySimSolver::Create(MakeParameters(Bodies, 0.0f, 1000.0f, 2.0f, 1.0f));
+	if (!TestNotNull(TEXT("Solver"), Solver.Get()))
+	{
+		return false;
+	}
+
+	Solver->Step();
+
+	TArrayView<const FVector2f> Positions = Solver->GetPositions();
+	TestTrue(TEXT("Leaving right comes back left"), Positions[0].Equals(FVector2f(-470.0f, 0.0f), 1e-3f));
+	TestTrue(TEXT("Leaving left comes back right"), Positions[1].Equals(FVector2f(480.0f, 200.0f), 1e-3f));
+	TestTrue(TEXT("Leaving bottom comes back top"), Positions[2].Equals(FVector2f(-200.0f, 240.0f), 1e-3f));
+	TestTrue(TEXT("Leaving top comes back bottom"), Positions[3].Equals(FVector2f(200.0f, -245.0f), 1e-3f));
+
+	// Velocities are untouched by wrapping.
+	for (int32 i = 0; i < Bodies.Num(); i++)
+	{
+		TestTrue(FString::Printf(TEXT("Velocity of body %d"), i), Solver->GetVelocities()[i].Equals(Bodies[i].Velocity));
+	}
+
+	// The kernel wraps the same way.
+	TestTrue(TEXT("Kernel"), FNBodySimKernels::WrapPosition(FVector2f(530.0f, -260.0f), 1000.0f, 2.0f).Equals(FVector2f(-470.0f, 240.0f), 1e-3f));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimSolverLeapfrogEnergyTest, "NBodySim.Solver.LeapfrogEnergy", NBodySimSolverTests::TestFlags)
+
+bool FNBodySimSolverLeapfrogEnergyTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimSolverTests;
+
+	const float G = 1000.0f;
+	const float Separation = 400.0f;
+
+	FNBodySimSolverOptions Options;
+	Options.Integrator = ENBodySimIntegrator::Leapfrog;
+
+	// About 700 steps per orbit, on a screen large enough to never wrap.
+	TUniquePtr<FNBodySimSolver> Solver = FNBodySimSolver::Create(MakeParameters(MakeCircularOrbit(1000.0f, Separation, G), G, 10000.0f, 1.0f, 0.05f), Options);
+	if (!TestNotNull(TEXT("Solver"), Solver.Get()))
+	{
+		return false;
+	}
+
+	const double InitialEnergy = ComputeEnergy(*Solver);
+	double MaxRelativeError = 0.0;
+
+	// About three orbits.
+	for (int32 Step = 0; Step < 2000; Step++)
+	{
+		Solver->Step();
+		MaxRelativeError = FMath::Max(MaxRelativeError, FMath::Abs((ComputeEnergy(*Solver) - InitialEnergy) / InitialEnergy));
+	}
+
+	// Leapfrog is symplectic, the energy error oscillates without drifting.
+	TestTrue(FString::Printf(TEXT("Energy error %g stays under 1e-3"), MaxRelativeError), MaxRelativeError < 1e-3);
+
+	const float FinalSeparation = (Solver->GetPositions()[1] - Solver->GetPositions()[0]).Size();
+	TestTrue(FString::Printf(TEXT("Separation %f stays circular"), FinalSeparation), FMath::IsNearlyEqual(FinalSeparation, Separation, Separation * 1e-2f));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimSolverLeapfrogReversibilityTest, "NBodySim.Solver.LeapfrogReversibility", NBodySimSolverTests::TestFlags)
+
+bool FNBodySimSolverLeapfrogReversibilityTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimSolverTests;
+
+	const int32 NumSteps = 200;
+
+	const TArray<FBodyData> Bodies = MakeRandomBodies(64, 2000.0f, 10.0f, 1234);
+
+	FNBodySimSolverOptions Options;
+	Options.Integrator = ENBodySimIntegrator::Leapfrog;
+
+	TUniquePtr<FNBodySimSolver> Solver = FNBodySimSolver::Create(MakeParameters(Bodies, 10.0f, 10000.0f, 1.0f, 0.1f), Options);
+	if (!TestNotNull(TEXT("Solver"), Solver.Get()))
+	{
+		return false;
+	}
+
+	Solver->Step(NumSteps);
+	TestTrue(TEXT("Bodies moved"), !Solver->GetPositions()[0].Equals(Bodies[0].Position, 1.0f));
+
+	TestTrue(TEXT("Step backward"), Solver->StepBackward(NumSteps));
+	TestEqual(TEXT("Step count"), Solver->GetStepCount(), static_cast<uint64>(0));
+
+	// Exact up to float rounding.
+	for (int32 i = 0; i < Bodies.Num(); i++)
+	{
+		TestTrue(FString::Printf(TEXT("Position of body %d"), i), Solver->GetPositions()[i].Equals(Bodies[i].Position, 1e-2f));
+		TestTrue(FString::Printf(TEXT("Velocity of body %d"), i), Solver->GetVelocities()[i].Equals(Bodies[i].Velocity, 1e-3f));
+	}
+
+	// Only the leapfrog is time reversible.
+	TUniquePtr<FNBodySimSolver> EulerSolver = FNBodySimSolver::Create(MakeParameters(Bodies, 10.0f, 10000.0f, 1.0f, 0.1f));
+	AddExpectedError(TEXT("only the leapfrog integrator is time reversible"), EAutomationExpectedErrorFlags::Contains, 1);
+	TestFalse(TEXT("Euler cannot step backward"), EulerSolver->StepBackward(1));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimSolverDeterminismTest, "NBodySim.Solver.Determinism", NBodySimSolverTests::TestFlags)
+
+bool FNBodySimSolverDeterminismTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimSolverTests;
+
+	// Not a multiple of the deterministic chunk size, on a screen small enough for bodies to wrap.
+	const FNBodySimParameters SimParameters = MakeParameters(MakeRandomBodies(700, 4000.0f, 200.0f, 42), 1000.0f, 8000.0f, 1.777778f, 1.0f / 60.0f);
+
+	// The calling thread only, then every worker with the default and the unbalanced scheduling.
+	const EParallelForFlags FlagsToTest[] = { EParallelForFlags::ForceSingleThread, EParallelForFlags::None, EParallelForFlags::Unbalanced };
+	const ENBodySimIntegrator IntegratorsToTest[] = { ENBodySimIntegrator::SemiImplicitEuler, ENBodySimIntegrator::Leapfrog, ENBodySimIntegrator::BlockTimesteps };
+
+	// Every body sums its forces serially and only writes its own slot, so the fast mode is as scheduling independent.
+	for (ENBodySimIntegrator Integrator : IntegratorsToTest)
+	{
+		TOptional<uint32> ReferenceHash;
+		for (EParallelForFlags Flags : FlagsToTest)
+		{
+			for (bool bDeterministic : { true, false })
+			{
+				FNBodySimSolverOptions Options;
+				Options.Integrator = Integrator;
+				Options.bDeterministic = bDeterministic;
+				Options.ParallelForFlags = Flags;
+				Options.ReorderInterval = 7;
+
+				TUniquePtr<FNBodySimSolver> Solver = FNBodySimSolver::Create(SimParameters, Options);
+				if (!TestNotNull(TEXT("Solver"), Solver.Get()))
+				{
+					return false;
+				}
+
+				Solver->Step(30);
+
+				const uint32 StateHash = Solver->ComputeStateHash();
+				if (!ReferenceHash.IsSet())
+				{
+					ReferenceHash = StateHash;
+				}
+				else
+				{
+					TestEqual(FString::Printf(TEXT("Integrator %d, ParallelFor flags %d, deterministic %d state hash"), static_cast<int32>(Integrator), static_cast<int32>(Flags), bDeterministic), StateHash, ReferenceHash.GetValue());
+				}
+			}
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimSolverBlockTimestepsTest, "NBodySim.Solver.BlockTimesteps", NBodySimSolverTests::TestFlags)
+
+bool FNBodySimSolverBlockTimestepsTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimSolverTests;
+
+	// A single level is the leapfrog, with the same operations in the same order.
+	{
+		const FNBodySimParameters SimParameters = MakeParameters(MakeRandomBodies(300, 4000.0f, 200.0f, 7), 1000.0f, 8000.0f, 1.777778f, 1.0f / 60.0f);
+
+		FNBodySimSolverOptions LeapfrogOptions;
+		LeapfrogOptions.Integrator = ENBodySimIntegrator::Leapfrog;
+
+		FNBodySimSolverOptions BlockOptions;
+		BlockOptions.Integrator = ENBodySimIntegrator::BlockTimesteps;
+		BlockOptions.MaxTimestepLevel = 0;
+
+		TUniquePtr<FNBodySimSolver> Leapfrog = FNBodySimSolver::Create(SimParameters, LeapfrogOptions);
+		TUniquePtr<FNBodySimSolver> Block = FNBodySimSolver::Create(SimParameters, BlockOptions);
+		if (!TestNotNull(TEXT("Leapfrog solver"), Leapfrog.Get()) || !TestNotNull(TEXT("Block timesteps solver"), Block.Get()))
+		{
+			return false;
+		}
+
+		for (int32 Step = 0; Step < 50; Step++)
+		{
+			Leapfrog->Step();
+			Block->Step();
+			TestEqual(TEXT("Single level force evaluations"), Block->GetLastStepForceEvaluations(), SimParameters.NumBodies);
+		}
+
+		TestEqual(TEXT("Single level state hash"), Block->ComputeStateHash(), Leapfrog->ComputeStateHash());
+		TestTrue(TEXT("Single level positions"), FMemory::Memcmp(Block->GetPositions().GetData(), Leapfrog->GetPositions().GetData(), SimParameters.NumBodies * sizeof(FVector2f)) == 0);
+		TestTrue(TEXT("Single level velocities"), FMemory::Memcmp(Block->GetVelocities().GetData(), Leapfrog->GetVelocities().GetData(), SimParameters.NumBodies * sizeof(FVector2f)) == 0);
+	}
+
+	// About 16 steps per orbit of the pair, too coarse for a plain leapfrog, while the light bodies need a single step.
+	const float G = 1000.0f;
+	const int32 NumSteps = 40;
+	const float MaxEnergyError = 1e-3f;
+	const FNBodySimParameters SimParameters = MakeParameters(MakeHeavyPairWithLightBodies(30, G, 3), G, 20000.0f, 1.0f, 0.25f);
+
+	double EnergyErrors[2] = { 0.0, 0.0 };
+	const ENBodySimIntegrator Integrators[2] = { ENBodySimIntegrator::Leapfrog, ENBodySimIntegrator::BlockTimesteps };
+
+	for (int32 IntegratorIndex = 0; IntegratorIndex < 2; IntegratorIndex++)
+	{
+		FNBodySimSolverOptions Options;
+		Options.Integrator = Integrators[IntegratorIndex];
+
+		TUniquePtr<FNBodySimSolver> Solver = FNBodySimSolver::Create(SimParameters, Options);
+		if (!TestNotNull(TEXT("Solver"), Solver.Get()))
+		{
+			return false;
+		}
+
+		const int32 SharedTimestepEvaluations = SimParameters.NumBodies << Options.MaxTimestepLevel;
+		const double InitialEnergy = ComputeEnergy(*Solver);
+		int32 MaxEvaluations = 0;
+
+		for (int32 Step = 0; Step < NumSteps; Step++)
+		{
+			Solver->Step();
+			EnergyErrors[IntegratorIndex] = FMath::Max(EnergyErrors[IntegratorIndex], FMath::Abs((ComputeEnergy(*Solver) - InitialEnergy) / InitialEnergy));
+
+			if (Options.Integrator == ENBodySimIntegrator::BlockTimesteps)
+			{
+				const int32 Evaluations = Solver->GetLastStepForceEvaluations();
+				TestTrue(FString::Printf(TEXT("Step %d : %d force evaluations, fewer than %d with a shared smallest timestep"), Step, Evaluations, SharedTimestepEvaluations), Evaluations < SharedTimestepEvaluations);
+				MaxEvaluations = FMath::Max(MaxEvaluations, Evaluations);
+			}
+		}
+
+		if (Options.Integrator == ENBodySimIntegrator::BlockTimesteps)
+		{
+			TestTrue(FString::Printf(TEXT("The pair takes smaller steps, %d force evaluations for %d bodies"), MaxEvaluations, SimParameters.NumBodies), MaxEvaluations > SimParameters.NumBodies);
+		}
+	}
+
+	TestTrue(FString::Printf(TEXT("Leapfrog energy error %g misses %g at this DeltaTime"), EnergyErrors[0], MaxEnergyError), EnergyErrors[0] > MaxEnergyError);
+	TestTrue(FString::Printf(TEXT("Block timesteps energy error %g stays under %g"), EnergyErrors[1], MaxEnergyError), EnergyErrors[1] < MaxEnergyError);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimSolverResizeBodiesTest, "NBodySim.Solver.ResizeBodies", NBodySimSolverTests::TestFlags)
+
+bool FNBodySimSolverResizeBodiesTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimSolverTests;
+
+	FNBodySimSolverOptions Options;
+	Options.Integrator = ENBodySimIntegrator::Leapfrog;
+	Options.ReorderInterval = 5;
+
+	// Reference runs started from the resized bodies, without reordering.
+	FNBodySimSolverOptions FreshOptions;
+	FreshOptions.Integrator = ENBodySimIntegrator::Leapfrog;
+
+	// On a screen large enough to never wrap, so nearly equal runs stay nearly equal.
+	TUniquePtr<FNBodySimSolver> Solver = FNBodySimSolver::Create(MakeParameters(MakeRandomBodies(300, 4000.0f, 200.0f, 5), 1000.0f, 10000.0f, 1.0f, 1.0f / 60.0f), Options);
+	if (!TestNotNull(TEXT("Solver"), Solver.Get()))
+	{
+		return false;
+	}
+
+	// Reordered first, so ids and slots differ when resizing.
+	Solver->Step(12);
+	TestTrue(TEXT("Bodies moved in memory before resizing"), Algo::AnyOf(Solver->GetBodyIds(), [Slot = 0](int32 Id) mutable { return Id != Slot++; }));
+
+	// Grown then shrunk.
+	for (int32 NewNumBodies : { 400, 150 })
+	{
+		const int32 OldNumBodies = Solver->GetNumBodies();
+		const FString What = FString::Printf(TEXT("%d -> %d bodies"), OldNumBodies, NewNumBodies);
+		const TArray<FBodyData> OldBodies = GetBodiesById(*Solver);
+		const TArray<FBodyData> Bodies = MakeRandomBodies(NewNumBodies, 4000.0f, 200.0f, NewNumBodies);
+
+		// Kept bodies in reverse id order, every third body and the ones past the old count spawning from Bodies.
+		TArray<int32> NewToOldIds;
+		for (int32 i = 0; i < NewNumBodies; i++)
+		{
+			const int32 OldId = OldNumBodies - 1 - i;
+			NewToOldIds.Add(i % 3 == 2 || OldId < 0 ? INDEX_NONE : OldId);
+		}
+
+		Solver->ResizeBodies(Bodies, NewToOldIds);
+
+		if (!TestEqual(What + TEXT(" count"), Solver->GetNumBodies(), NewNumBodies))
+		{
+			return false;
+		}
+		TestBodySlots(*this, What, *Solver);
+
+		const TArray<FBodyData> NewBodies = GetBodiesById(*Solver);
+		for (int32 i = 0; i < NewNumBodies; i++)
+		{
+			const int32 OldId = NewToOldIds[i];
+			const FBodyData& Expected = OldId != INDEX_NONE ? OldBodies[OldId] : Bodies[i];
+
+			if (NewBodies[i].Position != Expected.Position || NewBodies[i].Velocity != Expected.Velocity || NewBodies[i].Mass != Bodies[i].Mass)
+			{
+				AddError(FString::Printf(TEXT("%s : body %d from %d has mass %f, position (%f, %f) and velocity (%f, %f), expected %f, (%f, %f) and (%f, %f)."), *What, i, OldId,
+					NewBodies[i].Mass, NewBodies[i].Position.X, NewBodies[i].Position.Y, NewBodies[i].Velocity.X, NewBodies[i].Velocity.Y,
+					Bodies[i].Mass, Expected.Position.X, Expected.Position.Y, Expected.Velocity.X, Expected.Velocity.Y));
+				break;
+			}
+		}
+
+		// Accelerations cached before the resize are dropped, the next steps match a solver started from the resized bodies.
+		TUniquePtr<FNBodySimSolver> FreshSolver = FNBodySimSolver::Create(MakeParameters(NewBodies, 1000.0f, 10000.0f, 1.0f, 1.0f / 60.0f), FreshOptions);
+		if (!TestNotNull(TEXT("Fresh solver"), FreshSolver.Get()))
+		{
+			return false;
+		}
+
+		Solver->Step(3);
+		FreshSolver->Step(3);
+		TestBodySlots(*this, What + TEXT(" after stepping"), *Solver);
+
+		const TArray<FBodyData> SteppedBodies = GetBodiesById(*Solver);
+		const TArray<FBodyData> FreshBodies = GetBodiesById(*FreshSolver);
+		for (int32 i = 0; i < NewNumBodies; i++)
+		{
+			if (!SteppedBodies[i].Position.Equals(FreshBodies[i].Position, 1e-2f) || !SteppedBodies[i].Velocity.Equals(FreshBodies[i].Velocity, 1e-2f))
+			{
+				AddError(FString::Printf(TEXT("%s : body %d is at (%f, %f) moving at (%f, %f) after 3 steps, expected (%f, %f) moving at (%f, %f)."), *What, i,
+					SteppedBodies[i].Position.X, SteppedBodies[i].Position.Y, SteppedBodies[i].Velocity.X, SteppedBodies[i].Velocity.Y,
+					FreshBodies[i].Position.X, FreshBodies[i].Position.Y, FreshBodies[i].Velocity.X, FreshBodies[i].Velocity.Y));
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimSolverLiveChangesTest, "NBodySim.Solver.LiveChanges", NBodySimSolverTests::TestFlags)
+
+bool FNBodySimSolverLiveChangesTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimSolverTests;
+
+	const float G = 1000.0f;
+	const int32 ChangedBody = 7;
+	const float ChangedMass = 5000.0f;
+	const FNBodySimParameters SimParameters = MakeParameters(MakeRandomBodies(200, 4000.0f, 200.0f, 9), G, 10000.0f, 1.0f, 1.0f / 60.0f);
+
+	FNBodySimSolverOptions Options;
+	Options.Integrator = ENBodySimIntegrator::Leapfrog;
+
+	TUniquePtr<FNBodySimSolver> Solver = FNBodySimSolver::Create(SimParameters, Options);
+	if (!TestNotNull(TEXT("Solver"), Solver.Get()))
+	{
+		return false;
+	}
+
+	Solver->Step(10);
+
+	// Changed between two steps, the leapfrog must drop the accelerations it cached with the previous values.
+	FNBodySimState State;
+	Solver->SaveState(State);
+	Solver->SetGravityConstant(2.0f * G);
+	Solver->SetBodyMass(ChangedBody, ChangedMass);
+	Solver->Step(5);
+
+	TestEqual(TEXT("Gravity constant"), Solver->GetGravityConstant(), 2.0f * G);
+	TestEqual(TEXT("Changed mass"), Solver->GetMasses()[Solver->GetBodySlot(ChangedBody)], ChangedMass);
+
+	// The same state restored into a solver created with the new values. Without reordering, slots are ids.
+	FNBodySimParameters ChangedParameters = SimParameters;
+	ChangedParameters.GravityConstant = 2.0f * G;
+	State.Masses[ChangedBody] = ChangedMass;
+
+	TUniquePtr<FNBodySimSolver> Reference = FNBodySimSolver::Create(ChangedParameters, Options);
+	if (!TestNotNull(TEXT("Reference solver"), Reference.Get()))
+	{
+		return false;
+	}
+	Reference->RestoreState(State);
+	Reference->Step(5);
+
+	TestEqual(TEXT("State hash after changing the gravity constant and a mass"), Solver->ComputeStateHash(), Reference->ComputeStateHash());
+
+	// A smaller screen wraps every body back in at the next drift.
+	Solver->SetViewport(2000.0f, 2.0f);
+	TestEqual(TEXT("Viewport width"), Solver->GetViewportWidth(), 2000.0f);
+	TestEqual(TEXT("Camera aspect ratio"), Solver->GetCameraAspectRatio(), 2.0f);
+
+	Solver->Step();
+
+	int32 NumOutside = 0;
+	for (const FVector2f& Position : Solver->GetPositions())
+	{
+		if (FMath::Abs(Position.X) > 1000.0f || FMath::Abs(Position.Y) > 500.0f)
+		{
+			NumOutside++;
+		}
+	}
+	TestEqual(TEXT("Bodies outside of the smaller screen"), NumOutside, 0);
+
+	// Invalid viewports are rejected, keeping the current one.
+	AddExpectedError(TEXT("Ignoring invalid viewport"), EAutomationExpectedErrorFlags::Contains, 2);
+	Solver->SetViewport(0.0f, 1.0f);
+	Solver->SetViewport(1000.0f, -1.0f);
+	TestEqual(TEXT("Viewport width after invalid values"), Solver->GetViewportWidth(), 2000.0f);
+	TestEqual(TEXT("Camera aspect ratio after invalid values"), Solver->GetCameraAspectRatio(), 2.0f);
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,208 @@
+#include "Misc/AutomationTest.h"
+#include "NBodySimSpatialIndex.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace NBodySimSpatialIndexTests
+{
+	static constexpr uint32 TestFlags = EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter;
+
+	static const FBox2f Bounds(FVector2f(-1000.0f, -500.0f), FVector2f(1000.0f, 500.0f));
+
+	/** Random positions over an area larger than Bounds, so some bodies lie outside the grid. */
+	static TArray<FVector2f> MakePositions(int32 NumBodies, FRandomStream& Random)
+	{
+		TArray<FVector2f> Positions;
+		for (int32 i = 0; i < NumBodies; i++)
+		{
+			const float X = Random.FRandRange(-1200.0f, 1200.0f);
+			const float Y = Random.FRandRange(-700.0f, 700.0f);
+			Positions.Emplace(X, Y);
+		}
+		return Positions;
+	}
+
+	/** Query centers inside Bounds, on its border and far outside of it. */
+	static TArray<FVector2f> MakeCenters(FRandomStream& Random)
+	{
+		TArray<FVector2f> Centers;
+		for (int32 i = 0; i < 32; i++)
+		{
+			const float X = Random.FRandRange(-1000.0f, 1000.0f);
+			const float Y = Random.FRandRange(-500.0f, 500.0f);
+			Centers.Emplace(X, Y);
+		}
+
+		Centers.Append({ Bounds.Min, Bounds.Max, FVector2f(1000.0f, 0.0f), FVector2f(-3000.0f, 0.0f), FVector2f(0.0f, 2500.0f), FVector2f(5000.0f, -5000.0f), FVector2f(-1100.0f, 600.0f) });
+		return Centers;
+	}
+
+	static TArray<int32> Sorted(TArray<int32> Bodies)
+	{
+		Bodies.Sort();
+		return Bodies;
+	}
+
+	/** Compare every query of the snapshot with a brute force scan of Positions. */
+	static void TestQueries(FAutomationTestBase& Test, const FString& What, const FNBodySimSpatialSnapshot& Snapshot, TArrayView<const FVector2f> Positions, TArrayView<const FVector2f> Centers)
+	{
+		const float Radii[] = { 0.0f, 30.0f, 150.0f, 5000.0f };
+		const int32 Ks[] = { 1, 5, 40, Positions.Num(), Positions.Num() + 10 };
+
+		for (const FVector2f& Center : Centers)
+		{
+			const FString Where = FString::Printf(TEXT("%s around (%.1f, %.1f)"), *What, Center.X, Center.Y);
+
+			for (float Radius : Radii)
+			{
+				TArray<int32> Expected;
+				for (int32 Body = 0; Body < Positions.Num(); Body++)
+				{
+					if (FVector2f::DistSquared(Center, Positions[Body]) <= Radius * Radius)
+					{
+						Expected.Add(Body);
+					}
+				}
+
+				TArray<int32> Result;
+				Snapshot.QueryRadius(Center, Radius, Result);
+				Test.TestEqual(FString::Printf(TEXT("%s, radius %.0f"), *Where, Radius), Sorted(Result), Expected);
+			}
+
+			for (float HalfSize : Radii)
+			{
+				const FBox2f Box(Center - FVector2f(HalfSize, HalfSize * 0.5f), Center + FVector2f(HalfSize, HalfSize * 0.5f));
+
+				TArray<int32> Expected;
+				for (int32 Body = 0; Body < Positions.Num(); Body++)
+				{
+					if (Box.IsInside(Positions[Body]))
+					{
+						Expected.Add(Body);
+					}
+				}
+
+				TArray<int32> Result;
+				Snapshot.QueryBox(Box, Result);
+				Test.TestEqual(FString::Printf(TEXT("%s, box of half width %.0f"), *Where, HalfSize), Sorted(Result), Expected);
+			}
+
+			// Every distance, nearest first. Ties may pick different bodies, so compare distances.
+			TArray<float> SortedDistances;
+			for (const FVector2f& Position : Positions)
+			{
+				SortedDistances.Add(FVector2f::DistSquared(Center, Position));
+			}
+			SortedDistances.Sort();
+
+			for (int32 K : Ks)
+			{
+				TArray<int32> Result;
+				Snapshot.QueryKNearest(Center, K, Result);
+
+				const int32 ExpectedNum = FMath::Min(K, Positions.Num());
+				if (!Test.TestEqual(FString::Printf(TEXT("%s, %d nearest count"), *Where, K), Result.Num(), ExpectedNum))
+				{
+					continue;
+				}
+
+				for (int32 i = 0; i < ExpectedNum; i++)
+				{
+					if (FVector2f::DistSquared(Center, Positions[Result[i]]) != SortedDistances[i])
+					{
+						Test.AddError(FString::Printf(TEXT("%s, %d nearest : result %d is body %d at %f, expected a body at %f."),
+							*Where, K, i, Result[i], FMath::Sqrt(FVector2f::DistSquared(Center, Positions[Result[i]])), FMath::Sqrt(SortedDistances[i])));
+						break;
+					}
+				}
+
+				Test.TestEqual(FString::Printf(TEXT("%s, %d nearest are distinct"), *Where, K), TSet<int32>(Result).Num(), Result.Num());
+			}
+		}
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimSpatialIndexQueriesTest, "NBodySim.SpatialIndex.Queries", NBodySimSpatialIndexTests::TestFlags)
+
+bool FNBodySimSpatialIndexQueriesTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimSpatialIndexTests;
+
+	FRandomStream Random(3);
+	const TArray<FVector2f> Centers = MakeCenters(Random);
+
+	// From an empty grid to a few bodies per cell.
+	for (int32 NumBodies : { 0, 1, 7, 200, 3000 })
+	{
+		const TArray<FVector2f> Positions = MakePositions(NumBodies, Random);
+
+		FNBodySimSpatialIndex Index;
+		Index.Update(Positions, Bounds);
+
+		FNBodySimSpatialSnapshotPtr Snapshot = Index.GetSnapshot();
+		if (!TestNotNull(TEXT("Snapshot"), Snapshot.Get()))
+		{
+			return false;
+		}
+
+		TestQueries(*this, FString::Printf(TEXT("%d bodies"), NumBodies), *Snapshot, Positions, Centers);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimSpatialIndexIncrementalTest, "NBodySim.SpatialIndex.Incremental", NBodySimSpatialIndexTests::TestFlags)
+
+bool FNBodySimSpatialIndexIncrementalTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimSpatialIndexTests;
+
+	FRandomStream Random(11);
+	const TArray<FVector2f> Centers = MakeCenters(Random);
+	TArray<FVector2f> Positions = MakePositions(2000, Random);
+
+	FNBodySimSpatialIndex Index;
+	Index.Update(Positions, Bounds);
+
+	for (int32 Update = 0; Update < 6; Update++)
+	{
+		if (Update % 3 == 2)
+		{
+			// A few bodies jumping across the grid, more shifts than a full sort would take.
+			for (int32 i = 0; i < 100; i++)
+			{
+				Positions[Random.RandHelper(Positions.Num())] = FVector2f(Random.FRandRange(-1200.0f, 1200.0f), Random.FRandRange(-700.0f, 700.0f));
+			}
+		}
+		else
+		{
+			// Small moves, nearly sorted.
+			for (FVector2f& Position : Positions)
+			{
+				const float X = Random.FRandRange(-20.0f, 20.0f);
+				const float Y = Random.FRandRange(-20.0f, 20.0f);
+				Position += FVector2f(X, Y);
+			}
+		}
+
+		Index.Update(Positions, Bounds);
+
+		FNBodySimSpatialSnapshotPtr Snapshot = Index.GetSnapshot();
+		TestEqual(TEXT("Version"), Snapshot->Version, static_cast<uint64>(Update + 2));
+		TestQueries(*this, FString::Printf(TEXT("Update %d"), Update), *Snapshot, Positions, Centers);
+	}
+
+	// Body ids are returned instead of indices.
+	TArray<int32> BodyIds;
+	for (int32 i = 0; i < Positions.Num(); i++)
+	{
+		BodyIds.Add(Positions.Num() - 1 - i);
+	}
+	Index.Update(Positions, Bounds, BodyIds);
+
+	TArray<int32> Nearest;
+	Index.GetSnapshot()->QueryKNearest(Positions[5], 1, Nearest);
+	TestEqual(TEXT("Nearest body id"), Nearest.Num() == 1 ? Nearest[0] : INDEX_NONE, BodyIds[5]);
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
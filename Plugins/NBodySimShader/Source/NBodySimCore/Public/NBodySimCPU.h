@@ -0,0 +1,15 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FNBodySimEnsemble;
+
+/**
+ *	CPU counterpart of FNBodySimCSInterface. Mirrors the math of NBodySim.usf with ParallelFor.
+ */
+class NBODYSIMCORE_API FNBodySimCPUInterface
+{
+public:
+	/** Advance every system of the ensemble by NumSteps, one ParallelFor per pass over all bodies of all systems. */
+	static void StepEnsemble(FNBodySimEnsemble& Ensemble, int32 NumSteps);
+};
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "Containers/UnrealString.h"
+#include "Logging/LogMacros.h"
+
+NBODYSIMCORE_API DECLARE_LOG_CATEGORY_EXTERN(LogNBodySimCore, Log, All);
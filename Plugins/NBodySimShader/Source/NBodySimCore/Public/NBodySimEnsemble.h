@@ -0,0 +1,63 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FNBodySimParameters;
+
+/**
+ *	Which hardware advances the simulation.
+ */
+enum class ENBodySimBackend : uint8
+{
+	GPU,
+	CPU
+};
+
+/**
+ *	Constants of a single system inside an ensemble. Layout must match FSystemConstants in NBodySim.usf.
+ */
+struct FNBodySimSystemConstants
+{
+	/** Index of the first body of this system in the shared ensemble buffers. */
+	uint32 FirstBody;
+	uint32 NumBodies;
+	float GravityConstant;
+	float CameraAspectRatio;
+	float ViewportWidth;
+	float DeltaTime;
+
+	FNBodySimSystemConstants()
+		: FirstBody(0), NumBodies(0), GravityConstant(0), CameraAspectRatio(0), ViewportWidth(0), DeltaTime(0)
+	{
+	}
+};
+
+/**
+ *	Many independent small simulations packed into shared buffers so they can be advanced together
+ *	with the same two passes on the GPU (one dispatch each) and on the CPU (one ParallelFor each).
+ *	Bodies of system S live in [Systems[S].FirstBody, Systems[S].FirstBody + Systems[S].NumBodies).
+ */
+struct NBODYSIMCORE_API FNBodySimEnsemble
+{
+	TArray<FNBodySimSystemConstants> Systems;
+
+	/** For each body, the index of the system it belongs to. */
+	TArray<uint32> BodySystemIndices;
+
+	TArray<float> Masses;
+	TArray<FVector2f> Positions;
+	TArray<FVector2f> Velocities;
+
+	/** Pack the given independent systems into the shared buffers, replacing any previous content. */
+	void Pack(const TArray<FNBodySimParameters>& InSystems);
+
+	/** Set the same time step on every system. */
+	void SetDeltaTime(float DeltaTime);
+
+	int32 NumSystems() const { return Systems.Num(); }
+	int32 NumBodies() const { return Masses.Num(); }
+
+	/** Per-system results, views into the shared buffers. */
+	TArrayView<const FVector2f> GetSystemPositions(int32 SystemIndex) const;
+	TArrayView<const FVector2f> GetSystemVelocities(int32 SystemIndex) const;
+};
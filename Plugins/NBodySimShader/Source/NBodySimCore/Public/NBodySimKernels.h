@@ -0,0 +1,57 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ *	Force and wrapping kernels shared by every CPU code path. Mirrors the math of NBodySim.usf.
+ */
+struct FNBodySimKernels
+{
+	/**
+	 *	Since we do not handle collision, we cant really compute small distance force.
+	 *	This would make some body to get super high acceleration.
+	 *	We also avoid diving by zero.
+	 */
+	static constexpr float MinForceDistance = 100.0f;
+
+	/**
+	 *	Acceleration of body BodyID due to the bodies [FirstBody, FirstBody + NumBodies), self excluded.
+	 *	This is the gravitational force divided by the target's mass, which cancels out.
+	 *	Summed serially in index order by the calling thread, so the result only depends on the inputs, never on
+	 *	how bodies were spread over threads.
+	 */
+	static FORCEINLINE FVector2f ComputeAcceleration(uint32 BodyID, uint32 FirstBody, uint32 NumBodies, const float* Masses, const FVector2f* Positions, float GravityConstant)
+	{
+		const FVector2f Position = Positions[BodyID];
+
+		FVector2f Acceleration = FVector2f::ZeroVector;
+		for (uint32 i = FirstBody; i < FirstBody + NumBodies; i++)
+		{
+			// Skip if self.
+			if (i == BodyID) continue;
+
+			Acceleration += ComputePairAcceleration(Position, Positions[i], Masses[i], GravityConstant);
+		}
+		return Acceleration;
+	}
+
+	/** Acceleration applied on a body at Position by a body of mass OtherMass at OtherPosition. */
+	static FORCEINLINE FVector2f ComputePairAcceleration(const FVector2f& Position, const FVector2f& OtherPosition, float OtherMass, float GravityConstant)
+	{
+		const FVector2f Delta = OtherPosition - Position;
+		const float Distance = FMath::Max(Delta.Size(), MinForceDistance);
+
+		return Delta.GetSafeNormal() * (GravityConstant * OtherMass / (Distance * Distance));
+	}
+
+	/** Makes a position wrap along screen bounds, the screen being centered on (0,0). */
+	static FORCEINLINE FVector2f WrapPosition(FVector2f Position, float ViewportWidth, float CameraAspectRatio)
+	{
+		const FVector2f HalfScreen(ViewportWidth / 2.0f, ViewportWidth / CameraAspectRatio / 2.0f);
+
+		// FMath::Wrap already guards against zero-sized ranges.
+		Position.X = FMath::Wrap(Position.X, -HalfScreen.X, HalfScreen.X);
+		Position.Y = FMath::Wrap(Position.Y, -HalfScreen.Y, HalfScreen.Y);
+		return Position;
+	}
+};
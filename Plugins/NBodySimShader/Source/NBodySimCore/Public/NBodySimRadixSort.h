@@ -0,0 +1,16 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ *	Parallel least significant digit radix sort of 32 bits keys carrying an int32 value.
+ *	Stable, and its result does not depend on the worker count since work is split in fixed-size chunks.
+ */
+struct NBODYSIMCORE_API FNBodySimRadixSort
+{
+	/**
+	 *	Sort Keys and Values together by increasing key.
+	 *	TempKeys and TempValues are scratch buffers, resized as needed and kept by the caller to avoid reallocating.
+	 */
+	static void Sort(TArray<uint32>& Keys, TArray<int32>& Values, TArray<uint32>& TempKeys, TArray<int32>& TempValues);
+};
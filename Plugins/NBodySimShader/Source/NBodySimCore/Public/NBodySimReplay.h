@@ -0,0 +1,78 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NBodySimSolver.h"
+
+/**
+ *	Records periodic full-state keyframes of a solver in a ring buffer bounded by a memory budget,
+ *	so a run can be scrubbed back and forth without storing every frame.
+ *
+ *	Seeking restores the nearest previous keyframe and resimulates forward headless, which is exact
+ *	as long as the solver runs in deterministic mode with a fixed time step.
+ */
+class NBODYSIMCORE_API FNBodySimReplay
+{
+public:
+	/**
+	 *	@param InSolver				Solver to record and drive, must outlive the replay.
+	 *	@param InKeyframeInterval	Number of steps between two keyframes.
+	 *	@param MemoryBudget			Maximum memory used by the keyframes, in bytes. At least one keyframe is always kept.
+	 */
+	FNBodySimReplay(FNBodySimSolver& InSolver, int32 InKeyframeInterval, SIZE_T MemoryBudget);
+
+	/**
+	 *	Advance the live simulation by NumSteps, capturing keyframes on the way.
+	 *	After StepBackward, first restores the exact state of the current step from a keyframe.
+	 */
+	void Step(int32 NumSteps = 1);
+
+	/**
+	 *	Move the simulation to TargetStep, backward or forward.
+	 *	Returns false if TargetStep is older than the oldest keyframe still in the ring buffer.
+	 */
+	bool Seek(uint64 TargetStep);
+
+	/**
+	 *	Step back by NumSteps. Uses the leapfrog time reversibility when available, which is cheap
+	 *	but only exact up to float rounding, otherwise seeks from a keyframe.
+	 */
+	bool StepBackward(int32 NumSteps = 1);
+
+	uint64 GetCurrentStep() const { return Solver.GetStepCount(); }
+
+	/** Oldest step that can still be reached exactly. */
+	uint64 GetOldestStep() const;
+
+	/** Furthest step simulated so far. */
+	uint64 GetLatestStep() const { return LatestStep; }
+
+	int32 GetNumKeyframes() const { return NumKeyframes; }
+	int32 GetMaxKeyframes() const { return Keyframes.Num(); }
+
+private:
+	/** Save the solver's current state in the next ring buffer slot, overwriting the oldest keyframe when full. */
+	void CaptureKeyframe();
+
+	/** Resimulate the current step from its keyframe when the state is only approximate. Returns false without a keyframe to start from. */
+	bool RestoreExactState();
+
+	/** Ring buffer slot of the most recent keyframe at or before Step, INDEX_NONE if none. */
+	int32 FindKeyframe(uint64 Step) const;
+
+private:
+	FNBodySimSolver& Solver;
+
+	int32 KeyframeInterval;
+
+	/** Ring buffer of keyframes, allocated once up to the memory budget. */
+	TArray<FNBodySimState> Keyframes;
+
+	/** Slot of the oldest keyframe and number of valid keyframes from it. */
+	int32 OldestKeyframe = 0;
+	int32 NumKeyframes = 0;
+
+	uint64 LatestStep = 0;
+
+	/** False once the solver stepped backward through reversibility, its state is then only approximate. */
+	bool bExact = true;
+};
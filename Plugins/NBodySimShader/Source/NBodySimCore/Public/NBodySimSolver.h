@@ -0,0 +1,230 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/ParallelFor.h"
+#include "NBodySimSpaceFillingCurve.h"
+#include "NBodySimTypesDefinitions.h"
+
+/**
+ *	Time integration scheme of the CPU solver.
+ */
+enum class ENBodySimIntegrator : uint8
+{
+	/** Same scheme as the compute shader: kick velocities with the current forces, then drift positions. */
+	SemiImplicitEuler,
+
+	/** Kick-drift-kick leapfrog, second order and time reversible. */
+	Leapfrog,
+
+	/**
+	 *	Kick-drift-kick leapfrog with individual timesteps: DeltaTime is split in power-of-two bins and each body
+	 *	steps in the bin its acceleration and jerk call for. Only bodies ending their step get new forces.
+	 */
+	BlockTimesteps
+};
+
+/**
+ *	CPU only settings of the solver, on top of the FNBodySimParameters shared with the GPU path.
+ */
+struct FNBodySimSolverOptions
+{
+	ENBodySimIntegrator Integrator = ENBodySimIntegrator::SemiImplicitEuler;
+
+	/**
+	 *	Reproducible mode required by replays: work is split in fixed-size chunks, so task boundaries only depend on
+	 *	the body count. Results never depend on the worker count in either mode, every body sums its forces serially
+	 *	in index order and only writes its own slot.
+	 */
+	bool bDeterministic = false;
+
+	/** Flags of every ParallelFor of the solver, e.g. ForceSingleThread to keep it on the calling thread. */
+	EParallelForFlags ParallelForFlags = EParallelForFlags::None;
+
+	/** Emit a state hash every StateHashInterval steps, 0 to disable. */
+	int32 StateHashInterval = 0;
+
+	/** Called with the step count and the state hash every StateHashInterval steps. */
+	TFunction<void(uint64 Step, uint32 StateHash)> OnStateHash;
+
+	/** Reorder bodies in memory along a space-filling curve every ReorderInterval steps, 0 to disable. */
+	int32 ReorderInterval = 0;
+
+	ENBodySimSpaceFillingCurve ReorderCurve = ENBodySimSpaceFillingCurve::Hilbert;
+
+	/** Called after bodies moved in memory, with the previous slot of the body now in each slot. */
+	TFunction<void(TArrayView<const int32> NewToOldSlots)> OnBodiesReordered;
+
+	/** With block timesteps, the smallest step is DeltaTime / 2^MaxTimestepLevel. */
+	int32 MaxTimestepLevel = 6;
+
+	/** With block timesteps, accuracy factor of the per body timestep criteria. Smaller is more accurate and slower. */
+	float TimestepAccuracy = 0.025f;
+};
+
+/**
+ *	Full state of a solver at a given step, enough to resume the simulation bit for bit.
+ */
+struct FNBodySimState
+{
+	uint64 StepCount = 0;
+	float DeltaTime = 0.0f;
+
+	TArray<float> Masses;
+	TArray<FVector2f> Positions;
+	TArray<FVector2f> Velocities;
+	TArray<int32> BodyIds;
+
+	/** Timestep level of each body with block timesteps, empty otherwise. */
+	TArray<int32> TimestepLevels;
+
+	/** Memory used by a state of NumBodies bodies. */
+	static SIZE_T GetSizeForBodies(int32 NumBodies)
+	{
+		return sizeof(FNBodySimState) + NumBodies * (sizeof(float) + 2 * sizeof(FVector2f) + 2 * sizeof(int32));
+	}
+};
+
+/**
+ *	Headless N-Body solver running on CPU. Only depends on Core, so it can run without any
+ *	world, actor or renderer, e.g. from a program target, a commandlet or a test.
+ *
+ *	Bodies are stored as structure of arrays and advanced with ParallelFor.
+ */
+class NBODYSIMCORE_API FNBodySimSolver
+{
+public:
+	/** Create a solver from the same parameters as the GPU path. Returns null if the parameters are invalid. */
+	static TUniquePtr<FNBodySimSolver> Create(const FNBodySimParameters& Parameters, const FNBodySimSolverOptions& Options = FNBodySimSolverOptions());
+
+	/** Advance the simulation by NumSteps of the current DeltaTime. */
+	void Step(int32 NumSteps = 1);
+
+	void SetDeltaTime(float InDeltaTime) { DeltaTime = InDeltaTime; }
+	float GetDeltaTime() const { return DeltaTime; }
+
+	/** Change the simulation constants between two steps, without touching the bodies. */
+	void SetGravityConstant(float InGravityConstant);
+	void SetViewport(float InViewportWidth, float InCameraAspectRatio);
+
+	float GetGravityConstant() const { return GravityConstant; }
+	float GetViewportWidth() const { return ViewportWidth; }
+	float GetCameraAspectRatio() const { return CameraAspectRatio; }
+
+	/**
+	 *	Change the number of bodies. Body i keeps the position and velocity of the body of id NewToOldIds[i], or starts
+	 *	from Bodies[i] when INDEX_NONE, its mass always being Bodies[i].Mass. Bodies are then stored in id order,
+	 *	the id of a body being its index in Bodies.
+	 */
+	void ResizeBodies(TArrayView<const FBodyData> Bodies, TArrayView<const int32> NewToOldIds);
+
+	/** Change the mass of a body between two steps, keeping its position and velocity. */
+	void SetBodyMass(int32 BodyId, float Mass);
+
+	int32 GetNumBodies() const { return Masses.Num(); }
+	uint64 GetStepCount() const { return StepCount; }
+
+	/** With block timesteps, the number of body force evaluations of the last step, at most NumBodies * 2^MaxTimestepLevel. */
+	int32 GetLastStepForceEvaluations() const { return LastStepForceEvaluations; }
+
+	TArrayView<const float> GetMasses() const { return Masses; }
+	TArrayView<const FVector2f> GetPositions() const { return Positions; }
+	TArrayView<const FVector2f> GetVelocities() const { return Velocities; }
+
+	/**
+	 *	Bodies may move in memory when reordered, arrays above are indexed by slot.
+	 *	A body keeps the id of its initial slot for its whole life.
+	 */
+	TArrayView<const int32> GetBodyIds() const { return BodyIds; }
+	int32 GetBodySlot(int32 BodyId) const { return IdToSlot[BodyId]; }
+
+	/**
+	 *	Sort bodies in memory along the configured space-filling curve, so bodies close in space
+	 *	are close in memory. Called every ReorderInterval steps when enabled.
+	 */
+	void ReorderBodies();
+
+	/**
+	 *	Step back in time by NumSteps by integrating with a negated time step.
+	 *	Only available with the time reversible leapfrog integrator, returns false otherwise.
+	 *	The state matches the forward one up to float rounding, use a replay keyframe for exact seeking.
+	 */
+	bool StepBackward(int32 NumSteps = 1);
+
+	/** Copy the whole state into OutState, reusing its allocations. */
+	void SaveState(FNBodySimState& OutState) const;
+
+	/** Resume from a state saved by a solver with the same number of bodies. */
+	void RestoreState(const FNBodySimState& State);
+
+	const FNBodySimSolverOptions& GetOptions() const { return Options; }
+
+	/** Hash of the masses, positions and velocities bits. Identical states give identical hashes. */
+	uint32 ComputeStateHash() const;
+
+private:
+	FNBodySimSolver(const FNBodySimParameters& Parameters, const FNBodySimSolverOptions& InOptions);
+
+	void StepSemiImplicitEuler();
+	void StepLeapfrog();
+	void StepBlockTimesteps();
+
+	/** Timestep level of a body, the smallest whose step satisfies the acceleration and jerk criteria. */
+	int32 ComputeTimestepLevel(const FVector2f& Acceleration, const FVector2f& Jerk) const;
+
+	/** Fill Accelerations from the current positions. */
+	void ComputeAccelerations();
+
+	/** Fill OutAccelerations with the acceleration of each body of the compacted ActiveBodies list, from every body. */
+	void ComputeActiveAccelerations(TArrayView<const int32> InActiveBodies, TArrayView<FVector2f> OutAccelerations) const;
+
+	/** Advance positions by their velocities over Duration and wrap them along screen bounds. */
+	void Drift(float Duration);
+
+	/** Add Accelerations over Duration to the velocities. */
+	void Kick(float Duration);
+
+	/** Apply NewToOldSlots to Array through Scratch, which receives the previous allocation. */
+	template<typename ElementType>
+	static void PermuteArray(TArray<ElementType>& Array, TArray<ElementType>& Scratch, TArrayView<const int32> NewToOldSlots);
+
+	/** Run Function over [0, Num) in parallel, with a chunking that only depends on Num in deterministic mode. */
+	void ParallelForBodies(int32 Num, TFunctionRef<void(int32)> Function) const;
+
+private:
+	FNBodySimSolverOptions Options;
+
+	float GravityConstant;
+	float CameraAspectRatio;
+	float ViewportWidth;
+	float DeltaTime;
+
+	TArray<float> Masses;
+	TArray<FVector2f> Positions;
+	TArray<FVector2f> Velocities;
+	TArray<FVector2f> Accelerations;
+
+	/** Stable id of the body in each slot, and the other way around. */
+	TArray<int32> BodyIds;
+	TArray<int32> IdToSlot;
+
+	/** Reordering buffers, kept to avoid reallocating every reorder. */
+	TArray<uint32> ReorderKeys;
+	TArray<uint32> ReorderTempKeys;
+	TArray<int32> ReorderSlots;
+	TArray<int32> ReorderTempSlots;
+	TArray<float> ReorderScratchFloats;
+	TArray<FVector2f> ReorderScratchVectors;
+	TArray<int32> ReorderScratchIds;
+
+	/** Block timesteps: level of each body, its step being DeltaTime / 2^Level, and the bodies ending their step. */
+	TArray<int32> TimestepLevels;
+	TArray<int32> ActiveBodies;
+	TArray<FVector2f> ActiveAccelerations;
+	bool bTimestepLevelsValid = false;
+	int32 LastStepForceEvaluations = 0;
+
+	/** Leapfrog reuses the accelerations of the last kick as long as positions did not change since. */
+	bool bAccelerationsValid = false;
+
+	uint64 StepCount = 0;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ *	Which space-filling curve orders the bodies.
+ */
+enum class ENBodySimSpaceFillingCurve : uint8
+{
+	Morton,
+	Hilbert
+};
+
+/**
+ *	2D Morton (Z-order) codes: interleaving the bits of two 16 bits cell coordinates,
+ *	so that cells close in space get close keys.
+ */
+struct FNBodySimMorton
+{
+	/** Spread the lower 16 bits of X over the even bits of the result. */
+	static FORCEINLINE uint32 Part1By1(uint32 X)
+	{
+		X &= 0x0000FFFF;
+		X = (X | (X << 8)) & 0x00FF00FF;
+		X = (X | (X << 4)) & 0x0F0F0F0F;
+		X = (X | (X << 2)) & 0x33333333;
+		X = (X | (X << 1)) & 0x55555555;
+		return X;
+	}
+
+	/** Inverse of Part1By1, gather the even bits of X. */
+	static FORCEINLINE uint32 Compact1By1(uint32 X)
+	{
+		X &= 0x55555555;
+		X = (X | (X >> 1)) & 0x33333333;
+		X = (X | (X >> 2)) & 0x0F0F0F0F;
+		X = (X | (X >> 4)) & 0x00FF00FF;
+		X = (X | (X >> 8)) & 0x0000FFFF;
+		return X;
+	}
+
+	static FORCEINLINE uint32 Encode(uint32 X, uint32 Y)
+	{
+		return Part1By1(X) | (Part1By1(Y) << 1);
+	}
+
+	static FORCEINLINE void Decode(uint32 Code, uint32& OutX, uint32& OutY)
+	{
+		OutX = Compact1By1(Code);
+		OutY = Compact1By1(Code >> 1);
+	}
+};
+
+/**
+ *	2D Hilbert curve index of 16 bits cell coordinates. Slower to compute than Morton codes but
+ *	without the long jumps between quadrants, so consecutive keys are always neighbor cells.
+ */
+struct FNBodySimHilbert
+{
+	static constexpr uint32 GridSize = 1u << 16;
+
+	static FORCEINLINE uint32 Encode(uint32 X, uint32 Y)
+	{
+		uint32 Code = 0;
+		for (uint32 S = GridSize / 2; S > 0; S /= 2)
+		{
+			const uint32 RX = (X & S) ? 1 : 0;
+			const uint32 RY = (Y & S) ? 1 : 0;
+			Code += S * S * ((3 * RX) ^ RY);
+
+			// Rotate the quadrant so the sub-curve has the right orientation.
+			if (RY == 0)
+			{
+				if (RX == 1)
+				{
+					X = GridSize - 1 - X;
+					Y = GridSize - 1 - Y;
+				}
+				Swap(X, Y);
+			}
+		}
+		return Code;
+	}
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/ScopeRWLock.h"
+
+/**
+ *	Immutable picture of the bodies' positions at a given update, bucketed in a uniform grid
+ *	whose cells are laid out in Morton order. Queries only read it, so any number of threads
+ *	can run them concurrently while the next snapshot is being built.
+ *
+ *	Queries return body indices, i.e. indices in the positions array given to the index update,
+ *	or the body ids given along with the positions.
+ */
+struct NBODYSIMCORE_API FNBodySimSpatialSnapshot
+{
+	/** Incremented at every update of the owning index. */
+	uint64 Version = 0;
+
+	/** Area covered by the grid, positions outside are clamped to the border cells. */
+	FBox2f Bounds = FBox2f(ForceInit);
+
+	/** Number of cells along each axis, a power of two. */
+	int32 Resolution = 1;
+	FVector2f CellSize = FVector2f::UnitVector;
+
+	/** Bodies of the cell with Morton code C are [CellStart[C], CellStart[C + 1]) of the sorted arrays. */
+	TArray<uint32> CellStart;
+
+	/** Body indices and their positions, sorted by cell Morton code. */
+	TArray<int32> SortedBodies;
+	TArray<FVector2f> SortedPositions;
+
+	int32 GetNumBodies() const { return SortedBodies.Num(); }
+
+	/** Bodies inside Box, appended to OutBodies in no particular order. */
+	void QueryBox(const FBox2f& Box, TArray<int32>& OutBodies) const;
+
+	/** Bodies at most Radius away from Center, appended to OutBodies in no particular order. */
+	void QueryRadius(const FVector2f& Center, float Radius, TArray<int32>& OutBodies) const;
+
+	/** The K bodies nearest to Center, appended to OutBodies from the nearest to the furthest. */
+	void QueryKNearest(const FVector2f& Center, int32 K, TArray<int32>& OutBodies) const;
+
+	/** Cell coordinates of a position, clamped to the grid. */
+	FIntPoint GetCell(const FVector2f& Position) const;
+
+private:
+	/** Call Visitor(SortedIndex) for every body of the cells within [MinCell, MaxCell]. */
+	template<typename VisitorType>
+	void ForEachBodyInCells(const FIntPoint& MinCell, const FIntPoint& MaxCell, VisitorType&& Visitor) const;
+};
+
+using FNBodySimSpatialSnapshotPtr = TSharedPtr<const FNBodySimSpatialSnapshot, ESPMode::ThreadSafe>;
+
+/**
+ *	Spatial index over the simulated bodies, rebuilt from the positions buffer after each step.
+ *
+ *	The rebuild is incremental: bodies are re-keyed in the order of the previous update, which is
+ *	nearly sorted since bodies move little between two steps, and fixed with an insertion sort.
+ *	A full sort only happens when the body count or the grid changes, or when the insertion sort shifted
+ *	entries as many times as a full sort would compare them.
+ *
+ *	Each update publishes a new snapshot. Readers grab the current one and never wait for an update in progress.
+ */
+class NBODYSIMCORE_API FNBodySimSpatialIndex
+{
+public:
+	/**
+	 *	@param InTargetBodiesPerCell	Average number of bodies per cell used to pick the grid resolution.
+	 */
+	explicit FNBodySimSpatialIndex(int32 InTargetBodiesPerCell = 8);
+
+	/**
+	 *	Rebuild the index from Positions, covering Bounds, and publish the new snapshot. Not thread safe with itself.
+	 *	If given, BodyIds are returned by queries instead of indices in Positions, so results stay valid after a reorder.
+	 */
+	void Update(TArrayView<const FVector2f> Positions, const FBox2f& Bounds, TArrayView<const int32> BodyIds = TArrayView<const int32>());
+
+	/** Current snapshot, safe to call and to query from any thread. Null until the first update. */
+	FNBodySimSpatialSnapshotPtr GetSnapshot() const;
+
+	/** Batched queries against a single consistent snapshot, one result array per query, run in parallel. */
+	void QueryBoxBatch(TArrayView<const FBox2f> Boxes, TArray<TArray<int32>>& OutResults) const;
+	void QueryRadiusBatch(TArrayView<const FVector2f> Centers, float Radius, TArray<TArray<int32>>& OutResults) const;
+	void QueryKNearestBatch(TArrayView<const FVector2f> Centers, int32 K, TArray<TArray<int32>>& OutResults) const;
+
+private:
+	/** Grid resolution for NumBodies bodies. */
+	int32 ComputeResolution(int32 NumBodies) const;
+
+	/** A snapshot to fill, reusing the one before the current if no reader holds it anymore. */
+	TSharedPtr<FNBodySimSpatialSnapshot, ESPMode::ThreadSafe> AcquireSnapshotToBuild();
+
+private:
+	int32 TargetBodiesPerCell;
+
+	/** Cell Morton code in the upper 32 bits, body index in the lower ones, in the order of the last update. */
+	TArray<uint64> SortedEntries;
+
+	/** Grid of the last update, a change invalidates SortedEntries. */
+	int32 LastResolution = 0;
+	FBox2f LastBounds = FBox2f(ForceInit);
+
+	uint64 Version = 0;
+
+	mutable FRWLock SnapshotLock;
+	TSharedPtr<FNBodySimSpatialSnapshot, ESPMode::ThreadSafe> CurrentSnapshot;
+	TSharedPtr<FNBodySimSpatialSnapshot, ESPMode::ThreadSafe> PreviousSnapshot;
+};
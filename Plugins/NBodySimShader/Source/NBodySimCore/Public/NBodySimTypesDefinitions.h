@@ -1,6 +1,8 @@
 
 #pragma once
 
+#include "CoreMinimal.h"
+
 // #if defined(__cplusplus)
 // 	#define UINT_TYPE	unsigned int
 // 	#define INT_TYPE	int
@@ -34,6 +36,22 @@ struct FBodyData
 	}
 };
 
+// This struct contains all the data we need to pass from the game thread to compute on GPU or CPU.
+struct FNBodySimParameters
+{
+public:
+	TArray<FBodyData> Bodies;
+	uint32 NumBodies;
+	float GravityConstant;
+	float CameraAspectRatio;
+	float ViewportWidth;
+	float DeltaTime;
+	
+	FNBodySimParameters(): NumBodies(0), GravityConstant(0), CameraAspectRatio(0), ViewportWidth(0), DeltaTime(0)
+	{
+	}
+};
+
 
 // #undef UINT_TYPE
 // #undef INT_TYPE
\ No newline at end of file
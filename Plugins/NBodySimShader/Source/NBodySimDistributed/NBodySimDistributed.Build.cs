@@ -0,0 +1,26 @@
+
+
+namespace UnrealBuildTool.Rules
+{
+	public class NBodySimDistributed : ModuleRules
+	{
+		public NBodySimDistributed(ReadOnlyTargetRules Target)
+			: base(Target)
+		{
+			PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+
+			// Builds on the headless solver core, still without any Engine/Renderer dependency.
+			PublicDependencyModuleNames.AddRange(new string[]
+			{
+				"Core",
+				"NBodySimCore"
+			});
+
+			PrivateDependencyModuleNames.AddRange(new string[]
+			{
+				"Networking",
+				"Sockets"
+			});
+		}
+	}
+}
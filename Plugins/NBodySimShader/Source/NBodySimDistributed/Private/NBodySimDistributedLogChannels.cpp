@@ -0,0 +1,3 @@
+#include "NBodySimDistributedLogChannels.h"
+
+DEFINE_LOG_CATEGORY(LogNBodySimDistributed);
@@ -0,0 +1,5 @@
+
+#include "Modules/ModuleManager.h"
+
+// Like the solver core, the distributed solver has no module state.
+IMPLEMENT_MODULE(FDefaultModuleImpl, NBodySimDistributed)
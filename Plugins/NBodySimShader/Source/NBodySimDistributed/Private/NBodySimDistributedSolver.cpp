@@ -0,0 +1,537 @@
+#include "NBodySimDistributedSolver.h"
+
+#include "Algo/Partition.h"
+#include "Async/ParallelFor.h"
+#include "NBodySimDistributedLogChannels.h"
+#include "NBodySimKernels.h"
+#include "NBodySimTransport.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+DECLARE_STATS_GROUP(TEXT("NBodySimDistributed"), STATGROUP_NBodySimDistributed, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("NBodySimDistributed Step"), STAT_NBodySimDistributed_Step, STATGROUP_NBodySimDistributed);
+DECLARE_CYCLE_STAT(TEXT("NBodySimDistributed ExchangeSources"), STAT_NBodySimDistributed_ExchangeSources, STATGROUP_NBodySimDistributed);
+DECLARE_CYCLE_STAT(TEXT("NBodySimDistributed MigrateBodies"), STAT_NBodySimDistributed_MigrateBodies, STATGROUP_NBodySimDistributed);
+DECLARE_CYCLE_STAT(TEXT("NBodySimDistributed Rebalance"), STAT_NBodySimDistributed_Rebalance, STATGROUP_NBodySimDistributed);
+
+/** Bodies at the exact same position cannot be split, stop subdividing at some point. */
+static constexpr int32 MaxTreeDepth = 24;
+
+TUniquePtr<FNBodySimDistributedSolver> FNBodySimDistributedSolver::Create(const FNBodySimParameters& Parameters, INBodySimTransport& Transport, const FNBodySimDistributedOptions& Options)
+{
+	if (Parameters.CameraAspectRatio <= 0.0f || Parameters.ViewportWidth <= 0.0f)
+	{
+		UE_LOG(LogNBodySimDistributed, Error, TEXT("Failed to create distributed solver : invalid viewport (width %f, aspect ratio %f)."), Parameters.ViewportWidth, Parameters.CameraAspectRatio);
+		return nullptr;
+	}
+
+	if (Transport.GetNumRanks() <= 0 || Transport.GetRank() < 0 || Transport.GetRank() >= Transport.GetNumRanks())
+	{
+		UE_LOG(LogNBodySimDistributed, Error, TEXT("Failed to create distributed solver : invalid rank %d of %d."), Transport.GetRank(), Transport.GetNumRanks());
+		return nullptr;
+	}
+
+	return TUniquePtr<FNBodySimDistributedSolver>(new FNBodySimDistributedSolver(Parameters, Transport, Options));
+}
+
+FNBodySimDistributedSolver::FNBodySimDistributedSolver(const FNBodySimParameters& Parameters, INBodySimTransport& InTransport, const FNBodySimDistributedOptions& InOptions)
+	: Transport(InTransport)
+	, Options(InOptions)
+	, GravityConstant(Parameters.GravityConstant)
+	, CameraAspectRatio(Parameters.CameraAspectRatio)
+	, ViewportWidth(Parameters.ViewportWidth)
+	, DeltaTime(Parameters.DeltaTime)
+{
+	const FVector2f HalfScreen(ViewportWidth / 2.0f, ViewportWidth / CameraAspectRatio / 2.0f);
+	ScreenBounds = FBox2f(-HalfScreen, HalfScreen);
+
+	// Every rank has every body here, so they all build the same initial domains without communicating.
+	TArray<FVector2f> InitialPositions;
+	InitialPositions.SetNumUninitialized(Parameters.Bodies.Num());
+	for (int32 i = 0; i < Parameters.Bodies.Num(); ++i)
+	{
+		InitialPositions[i] = Parameters.Bodies[i].Position;
+	}
+
+	Domains.Build(ScreenBounds, InitialPositions, TArrayView<const float>(), Transport.GetNumRanks());
+
+	for (int32 i = 0; i < Parameters.Bodies.Num(); ++i)
+	{
+		const FBodyData& Body = Parameters.Bodies[i];
+		if (Domains.FindDomain(Body.Position) == GetRank())
+		{
+			AddLocalBody(Body.Mass, Body.Position, Body.Velocity, i);
+		}
+	}
+
+	UE_LOG(LogNBodySimDistributed, Log, TEXT("Rank %d owns %d of %d bodies."), GetRank(), GetNumLocalBodies(), Parameters.Bodies.Num());
+}
+
+int32 FNBodySimDistributedSolver::GetRank() const
+{
+	return Transport.GetRank();
+}
+
+bool FNBodySimDistributedSolver::Step(int32 NumSteps)
+{
+	SCOPE_CYCLE_COUNTER(STAT_NBodySimDistributed_Step);
+
+	for (int32 i = 0; i < NumSteps; ++i)
+	{
+		if (!ExchangeSources())
+		{
+			return false;
+		}
+
+		// Only the local work is timed, waiting for other ranks says nothing about this rank's load.
+		const double StartTime = FPlatformTime::Seconds();
+		ComputeAccelerations();
+		ComputeSeconds += FPlatformTime::Seconds() - StartTime;
+		++ComputeSteps;
+
+		Integrate();
+
+		if (!MigrateBodies())
+		{
+			return false;
+		}
+
+		++StepCount;
+
+		if (Options.RebalanceInterval > 0 && StepCount % Options.RebalanceInterval == 0 && !Rebalance())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FNBodySimDistributedSolver::ExchangeSources()
+{
+	SCOPE_CYCLE_COUNTER(STAT_NBodySimDistributed_ExchangeSources);
+
+	BuildTree();
+
+	const int32 NumRanks = Transport.GetNumRanks();
+	const int32 Rank = GetRank();
+
+	TArray<TArray<uint8>> Outgoing;
+	Outgoing.SetNum(NumRanks);
+
+	TArray<float> OutgoingMasses;
+	TArray<FVector2f> OutgoingPositions;
+
+	for (int32 OtherRank = 0; OtherRank < NumRanks; ++OtherRank)
+	{
+		if (OtherRank == Rank)
+		{
+			continue;
+		}
+
+		OutgoingMasses.Reset();
+		OutgoingPositions.Reset();
+		if (TreeNodes.Num() > 0)
+		{
+			AppendSources(0, Domains.GetDomainBounds(OtherRank), OutgoingMasses, OutgoingPositions);
+		}
+
+		FMemoryWriter Writer(Outgoing[OtherRank]);
+		Writer << OutgoingMasses << OutgoingPositions;
+	}
+
+	TArray<TArray<uint8>> Incoming;
+	if (!Transport.AllToAll(MoveTemp(Outgoing), Incoming))
+	{
+		UE_LOG(LogNBodySimDistributed, Error, TEXT("Rank %d lost another rank while exchanging sources."), Rank);
+		return false;
+	}
+
+	SourceMasses.Reset();
+	SourcePositions.Reset();
+
+	for (int32 OtherRank = 0; OtherRank < NumRanks; ++OtherRank)
+	{
+		if (OtherRank == Rank)
+		{
+			continue;
+		}
+
+		FMemoryReader Reader(Incoming[OtherRank]);
+		Reader << OutgoingMasses << OutgoingPositions;
+		SourceMasses.Append(OutgoingMasses);
+		SourcePositions.Append(OutgoingPositions);
+	}
+	return true;
+}
+
+void FNBodySimDistributedSolver::ComputeAccelerations()
+{
+	const int32 NumBodies = GetNumLocalBodies();
+	const int32 NumSources = SourceMasses.Num();
+	Accelerations.SetNumUninitialized(NumBodies, false);
+
+	const float* MassesData = Masses.GetData();
+	const FVector2f* PositionsData = Positions.GetData();
+	const float* SourceMassesData = SourceMasses.GetData();
+	const FVector2f* SourcePositionsData = SourcePositions.GetData();
+	FVector2f* AccelerationsData = Accelerations.GetData();
+	const float G = GravityConstant;
+
+	ParallelFor(NumBodies, [=](int32 BodyID)
+	{
+		FVector2f Acceleration = FNBodySimKernels::ComputeAcceleration(BodyID, 0, NumBodies, MassesData, PositionsData, G);
+
+		for (int32 i = 0; i < NumSources; ++i)
+		{
+			Acceleration += FNBodySimKernels::ComputePairAcceleration(PositionsData[BodyID], SourcePositionsData[i], SourceMassesData[i], G);
+		}
+		AccelerationsData[BodyID] = Acceleration;
+	});
+}
+
+void FNBodySimDistributedSolver::Integrate()
+{
+	const FVector2f* AccelerationsData = Accelerations.GetData();
+	FVector2f* PositionsData = Positions.GetData();
+	FVector2f* VelocitiesData = Velocities.GetData();
+	const float Dt = DeltaTime;
+	const float Width = ViewportWidth;
+	const float AspectRatio = CameraAspectRatio;
+
+	ParallelFor(GetNumLocalBodies(), [=](int32 BodyID)
+	{
+		VelocitiesData[BodyID] += AccelerationsData[BodyID] * Dt;
+		PositionsData[BodyID] = FNBodySimKernels::WrapPosition(PositionsData[BodyID] + VelocitiesData[BodyID] * Dt, Width, AspectRatio);
+	});
+}
+
+bool FNBodySimDistributedSolver::MigrateBodies()
+{
+	SCOPE_CYCLE_COUNTER(STAT_NBodySimDistributed_MigrateBodies);
+
+	const int32 NumRanks = Transport.GetNumRanks();
+	const int32 Rank = GetRank();
+
+	TArray<TArray<int32>> Leaving;
+	Leaving.SetNum(NumRanks);
+	TArray<int32> LeavingBodies;
+
+	for (int32 i = 0; i < GetNumLocalBodies(); ++i)
+	{
+		const int32 Owner = Domains.FindDomain(Positions[i]);
+		if (Owner != Rank)
+		{
+			Leaving[Owner].Add(i);
+			LeavingBodies.Add(i);
+		}
+	}
+
+	TArray<TArray<uint8>> Outgoing;
+	Outgoing.SetNum(NumRanks);
+
+	for (int32 OtherRank = 0; OtherRank < NumRanks; ++OtherRank)
+	{
+		if (OtherRank == Rank)
+		{
+			continue;
+		}
+
+		FMemoryWriter Writer(Outgoing[OtherRank]);
+		int32 NumMigrating = Leaving[OtherRank].Num();
+		Writer << NumMigrating;
+
+		for (int32 Index : Leaving[OtherRank])
+		{
+			Writer << Masses[Index] << Positions[Index] << Velocities[Index] << BodyIds[Index];
+		}
+	}
+
+	// From the last one, so swapped-in bodies have already been kept.
+	for (int32 i = LeavingBodies.Num() - 1; i >= 0; --i)
+	{
+		RemoveLocalBody(LeavingBodies[i]);
+	}
+
+	TArray<TArray<uint8>> Incoming;
+	if (!Transport.AllToAll(MoveTemp(Outgoing), Incoming))
+	{
+		UE_LOG(LogNBodySimDistributed, Error, TEXT("Rank %d lost another rank while migrating bodies."), Rank);
+		return false;
+	}
+
+	for (int32 OtherRank = 0; OtherRank < NumRanks; ++OtherRank)
+	{
+		if (OtherRank == Rank)
+		{
+			continue;
+		}
+
+		FMemoryReader Reader(Incoming[OtherRank]);
+		int32 NumMigrating = 0;
+		Reader << NumMigrating;
+
+		for (int32 i = 0; i < NumMigrating; ++i)
+		{
+			float Mass;
+			FVector2f Position;
+			FVector2f Velocity;
+			int32 BodyId;
+			Reader << Mass << Position << Velocity << BodyId;
+			AddLocalBody(Mass, Position, Velocity, BodyId);
+		}
+	}
+	return true;
+}
+
+bool FNBodySimDistributedSolver::Rebalance(bool bForce)
+{
+	SCOPE_CYCLE_COUNTER(STAT_NBodySimDistributed_Rebalance);
+
+	const int32 NumRanks = Transport.GetNumRanks();
+	const int32 Rank = GetRank();
+
+	// Each rank describes its load with its average force computation time and a sample of its positions.
+	double StepSeconds = ComputeSteps > 0 ? ComputeSeconds / ComputeSteps : 0.0;
+	ComputeSeconds = 0.0;
+	ComputeSteps = 0;
+
+	const int32 SampleStride = FMath::Max(1, FMath::DivideAndRoundUp(GetNumLocalBodies(), Options.MaxBalanceSamplesPerRank));
+	TArray<FVector2f> Samples;
+	for (int32 i = 0; i < GetNumLocalBodies(); i += SampleStride)
+	{
+		Samples.Add(Positions[i]);
+	}
+
+	TArray<uint8> Payload;
+	FMemoryWriter Writer(Payload);
+	Writer << StepSeconds << Samples;
+
+	TArray<TArray<uint8>> Payloads;
+	if (!Transport.AllGather(Payload, Payloads))
+	{
+		UE_LOG(LogNBodySimDistributed, Error, TEXT("Rank %d lost another rank while rebalancing."), Rank);
+		return false;
+	}
+
+	// Every rank reads the payloads in the same order and takes the same decision.
+	TArray<FVector2f> AllSamples;
+	TArray<float> AllWeights;
+	double TotalSeconds = 0.0;
+	double MaxSeconds = 0.0;
+
+	for (int32 OtherRank = 0; OtherRank < NumRanks; ++OtherRank)
+	{
+		FMemoryReader Reader(Payloads[OtherRank]);
+		double OtherSeconds = 0.0;
+		Reader << OtherSeconds << Samples;
+
+		TotalSeconds += OtherSeconds;
+		MaxSeconds = FMath::Max(MaxSeconds, OtherSeconds);
+
+		// Each sample stands for an equal share of its rank's time.
+		const float SampleWeight = Samples.Num() > 0 ? static_cast<float>(OtherSeconds / Samples.Num()) : 0.0f;
+		AllSamples.Append(Samples);
+		AllWeights.AddUninitialized(Samples.Num());
+		for (int32 i = AllWeights.Num() - Samples.Num(); i < AllWeights.Num(); ++i)
+		{
+			AllWeights[i] = SampleWeight;
+		}
+	}
+
+	const double AverageSeconds = TotalSeconds / NumRanks;
+	if (!bForce && (AverageSeconds <= 0.0 || MaxSeconds <= AverageSeconds * Options.RebalanceThreshold))
+	{
+		return true;
+	}
+
+	// Without any timing yet, balance the body count.
+	Domains.Build(ScreenBounds, AllSamples, TotalSeconds > 0.0 ? TArrayView<const float>(AllWeights) : TArrayView<const float>(), NumRanks);
+
+	const int32 NumBodiesBefore = GetNumLocalBodies();
+	if (!MigrateBodies())
+	{
+		return false;
+	}
+
+	UE_LOG(LogNBodySimDistributed, Log, TEXT("Rank %d rebalanced at step %llu (slowest %.3f ms, average %.3f ms), %d -> %d bodies."),
+		Rank, StepCount, MaxSeconds * 1000.0, AverageSeconds * 1000.0, NumBodiesBefore, GetNumLocalBodies());
+	return true;
+}
+
+bool FNBodySimDistributedSolver::GatherBodies(TArray<FBodyData>& OutBodies)
+{
+	const int32 Rank = GetRank();
+	OutBodies.Reset();
+
+	if (Rank != 0)
+	{
+		TArray<uint8> Payload;
+		FMemoryWriter Writer(Payload);
+		Writer << Masses << Positions << Velocities << BodyIds;
+		Transport.Send(0, MoveTemp(Payload));
+		return true;
+	}
+
+	auto PlaceBodies = [&OutBodies](TArrayView<const float> InMasses, TArrayView<const FVector2f> InPositions, TArrayView<const FVector2f> InVelocities, TArrayView<const int32> InBodyIds)
+	{
+		for (int32 i = 0; i < InBodyIds.Num(); ++i)
+		{
+			if (InBodyIds[i] >= OutBodies.Num())
+			{
+				OutBodies.SetNum(InBodyIds[i] + 1);
+			}
+			OutBodies[InBodyIds[i]] = FBodyData(InMasses[i], InPositions[i], InVelocities[i]);
+		}
+	};
+
+	PlaceBodies(Masses, Positions, Velocities, BodyIds);
+
+	TArray<float> RemoteMasses;
+	TArray<FVector2f> RemotePositions;
+	TArray<FVector2f> RemoteVelocities;
+	TArray<int32> RemoteBodyIds;
+
+	for (int32 OtherRank = 1; OtherRank < Transport.GetNumRanks(); ++OtherRank)
+	{
+		TArray<uint8> Payload;
+		if (!Transport.Receive(OtherRank, Payload))
+		{
+			UE_LOG(LogNBodySimDistributed, Error, TEXT("Rank %d went away while gathering bodies."), OtherRank);
+			return false;
+		}
+
+		FMemoryReader Reader(Payload);
+		Reader << RemoteMasses << RemotePositions << RemoteVelocities << RemoteBodyIds;
+		PlaceBodies(RemoteMasses, RemotePositions, RemoteVelocities, RemoteBodyIds);
+	}
+	return true;
+}
+
+void FNBodySimDistributedSolver::BuildTree()
+{
+	const int32 NumBodies = GetNumLocalBodies();
+
+	TreeNodes.Reset();
+	TreeBodies.SetNumUninitialized(NumBodies, false);
+	for (int32 i = 0; i < NumBodies; ++i)
+	{
+		TreeBodies[i] = i;
+	}
+
+	if (NumBodies == 0)
+	{
+		return;
+	}
+
+	FBox2f Bounds(ForceInit);
+	for (const FVector2f& Position : Positions)
+	{
+		Bounds += Position;
+	}
+
+	BuildTreeNode(Bounds, 0, NumBodies, 0);
+}
+
+int32 FNBodySimDistributedSolver::BuildTreeNode(const FBox2f& Bounds, int32 FirstBody, int32 NumBodies, int32 Depth)
+{
+	const int32 NodeIndex = TreeNodes.AddDefaulted();
+
+	FTreeNode Node;
+	Node.FirstBody = FirstBody;
+	Node.NumBodies = NumBodies;
+
+	FVector2f WeightedPositions = FVector2f::ZeroVector;
+	for (int32 i = FirstBody; i < FirstBody + NumBodies; ++i)
+	{
+		const int32 Body = TreeBodies[i];
+		Node.Mass += Masses[Body];
+		WeightedPositions += Positions[Body] * Masses[Body];
+		Node.Bounds += Positions[Body];
+	}
+	Node.CenterOfMass = Node.Mass > 0.0f ? WeightedPositions / Node.Mass : Node.Bounds.GetCenter();
+
+	if (NumBodies > Options.MaxLeafBodies && Depth < MaxTreeDepth)
+	{
+		const FVector2f Center = Bounds.GetCenter();
+		int32* Bodies = TreeBodies.GetData() + FirstBody;
+		const FVector2f* PositionsData = Positions.GetData();
+
+		// Split in halves along X, then each half along Y.
+		const int32 NumLeft = Algo::Partition(Bodies, NumBodies, [PositionsData, Center](int32 Body) { return PositionsData[Body].X < Center.X; });
+		const int32 NumBottomLeft = Algo::Partition(Bodies, NumLeft, [PositionsData, Center](int32 Body) { return PositionsData[Body].Y < Center.Y; });
+		const int32 NumBottomRight = Algo::Partition(Bodies + NumLeft, NumBodies - NumLeft, [PositionsData, Center](int32 Body) { return PositionsData[Body].Y < Center.Y; });
+
+		const int32 QuadrantStart[4] = { 0, NumBottomLeft, NumLeft, NumLeft + NumBottomRight };
+		const int32 QuadrantEnd[4] = { NumBottomLeft, NumLeft, NumLeft + NumBottomRight, NumBodies };
+
+		for (int32 Quadrant = 0; Quadrant < 4; ++Quadrant)
+		{
+			const bool bRight = Quadrant >= 2;
+			const bool bTop = (Quadrant % 2) == 1;
+			const FBox2f QuadrantBounds(
+				FVector2f(bRight ? Center.X : Bounds.Min.X, bTop ? Center.Y : Bounds.Min.Y),
+				FVector2f(bRight ? Bounds.Max.X : Center.X, bTop ? Bounds.Max.Y : Center.Y));
+
+			Node.Children[Quadrant] = BuildTreeNode(QuadrantBounds, FirstBody + QuadrantStart[Quadrant], QuadrantEnd[Quadrant] - QuadrantStart[Quadrant], Depth + 1);
+		}
+	}
+
+	// Children were added after this node, which may have moved in memory.
+	TreeNodes[NodeIndex] = Node;
+	return NodeIndex;
+}
+
+void FNBodySimDistributedSolver::AppendSources(int32 NodeIndex, const FBox2f& Target, TArray<float>& OutMasses, TArray<FVector2f>& OutPositions) const
+{
+	const FTreeNode& Node = TreeNodes[NodeIndex];
+	if (Node.NumBodies == 0)
+	{
+		return;
+	}
+
+	// Distance between the node's bodies and the closest point of the target domain.
+	const FVector2f Gap(
+		FMath::Max3(0.0f, Target.Min.X - Node.Bounds.Max.X, Node.Bounds.Min.X - Target.Max.X),
+		FMath::Max3(0.0f, Target.Min.Y - Node.Bounds.Max.Y, Node.Bounds.Min.Y - Target.Max.Y));
+	const float Distance = Gap.Size();
+	const FVector2f Size = Node.Bounds.GetSize();
+
+	if (Distance > 0.0f && FMath::Max(Size.X, Size.Y) < Options.OpeningAngle * Distance)
+	{
+		OutMasses.Add(Node.Mass);
+		OutPositions.Add(Node.CenterOfMass);
+		return;
+	}
+
+	if (Node.Children[0] == INDEX_NONE)
+	{
+		// Too close to be approximated, send the bodies themselves as ghosts.
+		for (int32 i = Node.FirstBody; i < Node.FirstBody + Node.NumBodies; ++i)
+		{
+			OutMasses.Add(Masses[TreeBodies[i]]);
+			OutPositions.Add(Positions[TreeBodies[i]]);
+		}
+		return;
+	}
+
+	for (int32 Child : Node.Children)
+	{
+		AppendSources(Child, Target, OutMasses, OutPositions);
+	}
+}
+
+void FNBodySimDistributedSolver::RemoveLocalBody(int32 Index)
+{
+	Masses.RemoveAtSwap(Index, 1, false);
+	Positions.RemoveAtSwap(Index, 1, false);
+	Velocities.RemoveAtSwap(Index, 1, false);
+	BodyIds.RemoveAtSwap(Index, 1, false);
+}
+
+void FNBodySimDistributedSolver::AddLocalBody(float Mass, const FVector2f& Position, const FVector2f& Velocity, int32 BodyId)
+{
+	Masses.Add(Mass);
+	Positions.Add(Position);
+	Velocities.Add(Velocity);
+	BodyIds.Add(BodyId);
+}
@@ -0,0 +1,99 @@
+#include "NBodySimDomainDecomposition.h"
+
+void FNBodySimDomainDecomposition::Build(const FBox2f& Bounds, TArrayView<const FVector2f> Points, TArrayView<const float> Weights, int32 NumDomains)
+{
+	check(NumDomains > 0);
+	check(Weights.Num() == 0 || Weights.Num() == Points.Num());
+
+	Nodes.Reset();
+	DomainBounds.SetNum(NumDomains);
+
+	TArray<int32> Indices;
+	Indices.SetNumUninitialized(Points.Num());
+	for (int32 i = 0; i < Points.Num(); ++i)
+	{
+		Indices[i] = i;
+	}
+
+	BuildNode(Bounds, Indices, 0, NumDomains, Points, Weights);
+}
+
+int32 FNBodySimDomainDecomposition::BuildNode(const FBox2f& Bounds, TArrayView<int32> Indices, int32 FirstDomain, int32 NumDomains, TArrayView<const FVector2f> Points, TArrayView<const float> Weights)
+{
+	const int32 NodeIndex = Nodes.AddDefaulted();
+
+	if (NumDomains == 1)
+	{
+		Nodes[NodeIndex].Domain = FirstDomain;
+		DomainBounds[FirstDomain] = Bounds;
+		return NodeIndex;
+	}
+
+	const FVector2f Size = Bounds.GetSize();
+	const int32 Axis = (Size.X >= Size.Y) ? 0 : 1;
+	const int32 NumLeftDomains = NumDomains / 2;
+	const float LeftFraction = static_cast<float>(NumLeftDomains) / NumDomains;
+
+	// Ties are ordered by sample index so every rank sorts the same way.
+	Indices.Sort([&Points, Axis](int32 A, int32 B)
+	{
+		const float CoordA = Points[A][Axis];
+		const float CoordB = Points[B][Axis];
+		return CoordA < CoordB || (CoordA == CoordB && A < B);
+	});
+
+	double TotalWeight = 0.0;
+	for (int32 Index : Indices)
+	{
+		TotalWeight += Weights.Num() > 0 ? Weights[Index] : 1.0f;
+	}
+
+	// Without samples, fall back to a geometric split.
+	float Split = Bounds.Min[Axis] + Size[Axis] * LeftFraction;
+	int32 NumLeftSamples = 0;
+
+	if (Indices.Num() > 0 && TotalWeight > 0.0)
+	{
+		const double TargetWeight = TotalWeight * LeftFraction;
+		double LeftWeight = 0.0;
+		while (NumLeftSamples < Indices.Num() && LeftWeight < TargetWeight)
+		{
+			LeftWeight += Weights.Num() > 0 ? Weights[Indices[NumLeftSamples]] : 1.0f;
+			++NumLeftSamples;
+		}
+
+		// Cut halfway between the last sample on the left and the first one on the right.
+		const float LastLeft = NumLeftSamples > 0 ? Points[Indices[NumLeftSamples - 1]][Axis] : Bounds.Min[Axis];
+		const float FirstRight = NumLeftSamples < Indices.Num() ? Points[Indices[NumLeftSamples]][Axis] : Bounds.Max[Axis];
+		Split = FMath::Clamp((LastLeft + FirstRight) * 0.5f, Bounds.Min[Axis], Bounds.Max[Axis]);
+	}
+
+	FBox2f LeftBounds = Bounds;
+	FBox2f RightBounds = Bounds;
+	LeftBounds.Max[Axis] = Split;
+	RightBounds.Min[Axis] = Split;
+
+	const int32 LeftChild = BuildNode(LeftBounds, Indices.Slice(0, NumLeftSamples), FirstDomain, NumLeftDomains, Points, Weights);
+	const int32 RightChild = BuildNode(RightBounds, Indices.Slice(NumLeftSamples, Indices.Num() - NumLeftSamples), FirstDomain + NumLeftDomains, NumDomains - NumLeftDomains, Points, Weights);
+
+	// Nodes may have been reallocated by the recursion.
+	FNode& Node = Nodes[NodeIndex];
+	Node.Axis = Axis;
+	Node.Split = Split;
+	Node.Children[0] = LeftChild;
+	Node.Children[1] = RightChild;
+	return NodeIndex;
+}
+
+int32 FNBodySimDomainDecomposition::FindDomain(const FVector2f& Position) const
+{
+	check(Nodes.Num() > 0);
+
+	int32 NodeIndex = 0;
+	while (Nodes[NodeIndex].Domain == INDEX_NONE)
+	{
+		const FNode& Node = Nodes[NodeIndex];
+		NodeIndex = Node.Children[Position[Node.Axis] < Node.Split ? 0 : 1];
+	}
+	return Nodes[NodeIndex].Domain;
+}
@@ -0,0 +1,312 @@
+#include "NBodySimTcpTransport.h"
+
+#include "Common/TcpSocketBuilder.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Interfaces/IPv4/IPv4Endpoint.h"
+#include "NBodySimDistributedLogChannels.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+#include <atomic>
+
+/**
+ *	Connection to another rank, with the thread receiving its messages.
+ */
+struct FNBodySimTcpTransport::FPeer : public FRunnable
+{
+	FSocket* Socket = nullptr;
+	FRunnableThread* Thread = nullptr;
+
+	/** Written by the receiving thread only, read by the simulation thread only. */
+	TQueue<TArray<uint8>, EQueueMode::Spsc> Inbox;
+	FEvent* InboxEvent = nullptr;
+
+	/** Messages must not interleave when several threads send to the same peer. */
+	FCriticalSection SendLock;
+
+	std::atomic<bool> bConnected { false };
+	std::atomic<bool> bStopping { false };
+
+	FPeer()
+	{
+		InboxEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	}
+
+	virtual ~FPeer() override
+	{
+		bStopping = true;
+
+		if (Socket)
+		{
+			// Unblocks the receiving thread.
+			Socket->Shutdown(ESocketShutdownMode::ReadWrite);
+			Socket->Close();
+		}
+
+		if (Thread)
+		{
+			Thread->WaitForCompletion();
+			delete Thread;
+		}
+
+		if (Socket)
+		{
+			ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+		}
+
+		FPlatformProcess::ReturnSynchEventToPool(InboxEvent);
+	}
+
+	virtual uint32 Run() override
+	{
+		while (!bStopping)
+		{
+			int32 Size = 0;
+			if (!ReceiveAll(Socket, reinterpret_cast<uint8*>(&Size), sizeof(Size)))
+			{
+				break;
+			}
+
+			if (Size < 0 || Size > MaxMessageSize)
+			{
+				UE_LOG(LogNBodySimDistributed, Error, TEXT("Received an invalid message size %d, dropping the connection."), Size);
+				break;
+			}
+
+			TArray<uint8> Message;
+			Message.SetNumUninitialized(Size);
+			if (!ReceiveAll(Socket, Message.GetData(), Size))
+			{
+				break;
+			}
+
+			Inbox.Enqueue(MoveTemp(Message));
+			InboxEvent->Trigger();
+		}
+
+		bConnected = false;
+		InboxEvent->Trigger();
+		return 0;
+	}
+};
+
+TUniquePtr<FNBodySimTcpTransport> FNBodySimTcpTransport::Create(int32 Rank, const TArray<FString>& Endpoints, float TimeoutSeconds)
+{
+	const int32 NumRanks = Endpoints.Num();
+	if (!Endpoints.IsValidIndex(Rank))
+	{
+		UE_LOG(LogNBodySimDistributed, Error, TEXT("Invalid rank %d for %d endpoints."), Rank, NumRanks);
+		return nullptr;
+	}
+
+	TArray<FIPv4Endpoint> Addresses;
+	for (const FString& Endpoint : Endpoints)
+	{
+		if (!FIPv4Endpoint::Parse(Endpoint, Addresses.AddDefaulted_GetRef()))
+		{
+			UE_LOG(LogNBodySimDistributed, Error, TEXT("Invalid endpoint '%s', expected ip:port."), *Endpoint);
+			return nullptr;
+		}
+	}
+
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	TUniquePtr<FNBodySimTcpTransport> Transport(new FNBodySimTcpTransport(Rank, NumRanks));
+
+	FSocket* Listener = FTcpSocketBuilder(TEXT("NBodySimListener"))
+		.AsReusable()
+		.BoundToEndpoint(FIPv4Endpoint(FIPv4Address::Any, Addresses[Rank].Port))
+		.Listening(NumRanks);
+
+	if (!Listener)
+	{
+		UE_LOG(LogNBodySimDistributed, Error, TEXT("Rank %d failed to listen on %s."), Rank, *Endpoints[Rank]);
+		return nullptr;
+	}
+
+	const double Deadline = FPlatformTime::Seconds() + TimeoutSeconds;
+
+	// Connect to the lower ranks, retrying until they are listening.
+	for (int32 PeerRank = 0; PeerRank < Rank; ++PeerRank)
+	{
+		while (!Transport->Peers[PeerRank]->Socket && FPlatformTime::Seconds() < Deadline)
+		{
+			FSocket* Socket = FTcpSocketBuilder(TEXT("NBodySimPeer")).AsBlocking();
+			if (Socket && Socket->Connect(*Addresses[PeerRank].ToInternetAddr()) && SendAll(Socket, reinterpret_cast<const uint8*>(&Rank), sizeof(Rank)))
+			{
+				Transport->Peers[PeerRank]->Socket = Socket;
+				break;
+			}
+
+			if (Socket)
+			{
+				SocketSubsystem->DestroySocket(Socket);
+			}
+			FPlatformProcess::Sleep(0.1f);
+		}
+	}
+
+	// Accept the higher ranks, which introduce themselves with their rank.
+	int32 NumAccepted = 0;
+	while (NumAccepted < NumRanks - 1 - Rank && FPlatformTime::Seconds() < Deadline)
+	{
+		bool bHasPendingConnection = false;
+		if (!Listener->HasPendingConnection(bHasPendingConnection) || !bHasPendingConnection)
+		{
+			FPlatformProcess::Sleep(0.01f);
+			continue;
+		}
+
+		FSocket* Socket = Listener->Accept(TEXT("NBodySimPeer"));
+		if (!Socket)
+		{
+			continue;
+		}
+		Socket->SetNonBlocking(false);
+
+		// A peer that never introduces itself must not hold the mesh past the deadline.
+		int32 PeerRank = INDEX_NONE;
+		if (!ReceiveAll(Socket, reinterpret_cast<uint8*>(&PeerRank), sizeof(PeerRank), Deadline) || PeerRank <= Rank || PeerRank >= NumRanks || Transport->Peers[PeerRank]->Socket)
+		{
+			UE_LOG(LogNBodySimDistributed, Warning, TEXT("Rank %d rejected an unexpected connection (rank %d)."), Rank, PeerRank);
+			SocketSubsystem->DestroySocket(Socket);
+			continue;
+		}
+
+		Transport->Peers[PeerRank]->Socket = Socket;
+		++NumAccepted;
+	}
+
+	SocketSubsystem->DestroySocket(Listener);
+
+	for (int32 PeerRank = 0; PeerRank < NumRanks; ++PeerRank)
+	{
+		if (PeerRank != Rank && !Transport->Peers[PeerRank]->Socket)
+		{
+			UE_LOG(LogNBodySimDistributed, Error, TEXT("Rank %d timed out waiting for rank %d at %s."), Rank, PeerRank, *Endpoints[PeerRank]);
+			return nullptr;
+		}
+	}
+
+	Transport->StartReceiving();
+
+	UE_LOG(LogNBodySimDistributed, Log, TEXT("Rank %d connected to %d other ranks."), Rank, NumRanks - 1);
+	return Transport;
+}
+
+FNBodySimTcpTransport::FNBodySimTcpTransport(int32 InRank, int32 NumRanks)
+	: Rank(InRank)
+{
+	for (int32 PeerRank = 0; PeerRank < NumRanks; ++PeerRank)
+	{
+		Peers.Add(MakeUnique<FPeer>());
+	}
+}
+
+FNBodySimTcpTransport::~FNBodySimTcpTransport()
+{
+	Peers.Empty();
+}
+
+void FNBodySimTcpTransport::StartReceiving()
+{
+	for (int32 PeerRank = 0; PeerRank < Peers.Num(); ++PeerRank)
+	{
+		FPeer& Peer = *Peers[PeerRank];
+		if (PeerRank != Rank)
+		{
+			Peer.bConnected = true;
+			Peer.Thread = FRunnableThread::Create(&Peer, *FString::Printf(TEXT("NBodySimTcpReceive%d"), PeerRank));
+		}
+	}
+}
+
+void FNBodySimTcpTransport::Send(int32 ToRank, TArray<uint8>&& Message)
+{
+	check(ToRank != Rank);
+	FPeer& Peer = *Peers[ToRank];
+
+	// Frame every message with its size.
+	const int32 Size = Message.Num();
+	if (Size > MaxMessageSize)
+	{
+		UE_LOG(LogNBodySimDistributed, Error, TEXT("Rank %d cannot send %d bytes to rank %d, messages are limited to %d bytes."), Rank, Size, ToRank, MaxMessageSize);
+		return;
+	}
+
+	FScopeLock Lock(&Peer.SendLock);
+	if (!SendAll(Peer.Socket, reinterpret_cast<const uint8*>(&Size), sizeof(Size)) || !SendAll(Peer.Socket, Message.GetData(), Size))
+	{
+		UE_LOG(LogNBodySimDistributed, Warning, TEXT("Rank %d failed to send %d bytes to rank %d."), Rank, Size, ToRank);
+	}
+}
+
+bool FNBodySimTcpTransport::Receive(int32 FromRank, TArray<uint8>& OutMessage)
+{
+	check(FromRank != Rank);
+	FPeer& Peer = *Peers[FromRank];
+
+	while (!Peer.Inbox.Dequeue(OutMessage))
+	{
+		if (!Peer.bConnected)
+		{
+			// Messages received right before the disconnection are still delivered.
+			return Peer.Inbox.Dequeue(OutMessage);
+		}
+		Peer.InboxEvent->Wait();
+	}
+	return true;
+}
+
+void FNBodySimTcpTransport::Close()
+{
+	// The other ranks see the connection end once they have read everything sent before.
+	for (int32 PeerRank = 0; PeerRank < Peers.Num(); ++PeerRank)
+	{
+		FPeer& Peer = *Peers[PeerRank];
+		if (PeerRank != Rank && Peer.Socket)
+		{
+			FScopeLock Lock(&Peer.SendLock);
+			Peer.Socket->Shutdown(ESocketShutdownMode::ReadWrite);
+		}
+	}
+}
+
+bool FNBodySimTcpTransport::ReceiveAll(FSocket* Socket, uint8* Data, int32 Size, double Deadline)
+{
+	while (Size > 0)
+	{
+		if (Deadline > 0.0)
+		{
+			const double RemainingSeconds = Deadline - FPlatformTime::Seconds();
+			if (RemainingSeconds <= 0.0 || !Socket->Wait(ESocketWaitConditions::WaitForRead, FTimespan::FromSeconds(RemainingSeconds)))
+			{
+				return false;
+			}
+		}
+
+		int32 BytesRead = 0;
+		if (!Socket->Recv(Data, Size, BytesRead) || BytesRead <= 0)
+		{
+			return false;
+		}
+		Data += BytesRead;
+		Size -= BytesRead;
+	}
+	return true;
+}
+
+bool FNBodySimTcpTransport::SendAll(FSocket* Socket, const uint8* Data, int32 Size)
+{
+	while (Size > 0)
+	{
+		int32 BytesSent = 0;
+		if (!Socket->Send(Data, Size, BytesSent) || BytesSent <= 0)
+		{
+			return false;
+		}
+		Data += BytesSent;
+		Size -= BytesSent;
+	}
+	return true;
+}
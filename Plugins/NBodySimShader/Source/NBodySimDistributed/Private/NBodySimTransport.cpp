@@ -0,0 +1,153 @@
+#include "NBodySimTransport.h"
+
+#include "HAL/PlatformProcess.h"
+
+bool INBodySimTransport::AllGather(const TArray<uint8>& Payload, TArray<TArray<uint8>>& OutPayloads)
+{
+	const int32 NumRanks = GetNumRanks();
+	const int32 Rank = GetRank();
+
+	OutPayloads.SetNum(NumRanks);
+
+	for (int32 OtherRank = 0; OtherRank < NumRanks; ++OtherRank)
+	{
+		if (OtherRank != Rank)
+		{
+			TArray<uint8> Copy = Payload;
+			Send(OtherRank, MoveTemp(Copy));
+		}
+	}
+
+	OutPayloads[Rank] = Payload;
+
+	for (int32 OtherRank = 0; OtherRank < NumRanks; ++OtherRank)
+	{
+		if (OtherRank != Rank && !Receive(OtherRank, OutPayloads[OtherRank]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool INBodySimTransport::AllToAll(TArray<TArray<uint8>>&& Outgoing, TArray<TArray<uint8>>& OutIncoming)
+{
+	const int32 NumRanks = GetNumRanks();
+	const int32 Rank = GetRank();
+	check(Outgoing.Num() == NumRanks);
+
+	OutIncoming.SetNum(NumRanks);
+
+	for (int32 OtherRank = 0; OtherRank < NumRanks; ++OtherRank)
+	{
+		if (OtherRank != Rank)
+		{
+			Send(OtherRank, MoveTemp(Outgoing[OtherRank]));
+		}
+	}
+
+	OutIncoming[Rank] = MoveTemp(Outgoing[Rank]);
+
+	for (int32 OtherRank = 0; OtherRank < NumRanks; ++OtherRank)
+	{
+		if (OtherRank != Rank && !Receive(OtherRank, OutIncoming[OtherRank]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+FNBodySimSharedMemoryHub::FNBodySimSharedMemoryHub(int32 InNumRanks)
+	: NumRanks(InNumRanks)
+{
+	for (int32 i = 0; i < NumRanks * NumRanks; ++i)
+	{
+		TUniquePtr<FMailbox>& Mailbox = Mailboxes.Add_GetRef(MakeUnique<FMailbox>());
+		Mailbox->MessageEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	}
+}
+
+FNBodySimSharedMemoryHub::~FNBodySimSharedMemoryHub()
+{
+	for (TUniquePtr<FMailbox>& Mailbox : Mailboxes)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(Mailbox->MessageEvent);
+	}
+}
+
+void FNBodySimSharedMemoryHub::Post(int32 FromRank, int32 ToRank, TArray<uint8>&& Message)
+{
+	FMailbox& Mailbox = GetMailbox(FromRank, ToRank);
+	Mailbox.Messages.Enqueue(MoveTemp(Message));
+	Mailbox.MessageEvent->Trigger();
+}
+
+bool FNBodySimSharedMemoryHub::Wait(int32 FromRank, int32 ToRank, TArray<uint8>& OutMessage)
+{
+	FMailbox& Mailbox = GetMailbox(FromRank, ToRank);
+
+	// Auto reset event, a trigger between a failed dequeue and the wait is not lost.
+	while (!Mailbox.Messages.Dequeue(OutMessage))
+	{
+		if (Mailbox.bSenderClosed)
+		{
+			// Messages posted right before closing are still delivered.
+			return Mailbox.Messages.Dequeue(OutMessage);
+		}
+		Mailbox.MessageEvent->Wait();
+	}
+	return true;
+}
+
+void FNBodySimSharedMemoryHub::Close(int32 Rank)
+{
+	for (int32 ToRank = 0; ToRank < NumRanks; ++ToRank)
+	{
+		FMailbox& Mailbox = GetMailbox(Rank, ToRank);
+		Mailbox.bSenderClosed = true;
+		Mailbox.MessageEvent->Trigger();
+	}
+}
+
+
+TArray<TUniquePtr<FNBodySimSharedMemoryTransport>> FNBodySimSharedMemoryTransport::CreateRanks(int32 NumRanks)
+{
+	TSharedRef<FNBodySimSharedMemoryHub> Hub = MakeShared<FNBodySimSharedMemoryHub>(NumRanks);
+
+	TArray<TUniquePtr<FNBodySimSharedMemoryTransport>> Transports;
+	for (int32 Rank = 0; Rank < NumRanks; ++Rank)
+	{
+		Transports.Add(MakeUnique<FNBodySimSharedMemoryTransport>(Hub, Rank));
+	}
+	return Transports;
+}
+
+FNBodySimSharedMemoryTransport::FNBodySimSharedMemoryTransport(TSharedRef<FNBodySimSharedMemoryHub> InHub, int32 InRank)
+	: Hub(InHub)
+	, Rank(InRank)
+{
+}
+
+FNBodySimSharedMemoryTransport::~FNBodySimSharedMemoryTransport()
+{
+	Close();
+}
+
+void FNBodySimSharedMemoryTransport::Send(int32 ToRank, TArray<uint8>&& Message)
+{
+	check(ToRank != Rank);
+	Hub->Post(Rank, ToRank, MoveTemp(Message));
+}
+
+bool FNBodySimSharedMemoryTransport::Receive(int32 FromRank, TArray<uint8>& OutMessage)
+{
+	check(FromRank != Rank);
+	return Hub->Wait(FromRank, Rank, OutMessage);
+}
+
+void FNBodySimSharedMemoryTransport::Close()
+{
+	Hub->Close(Rank);
+}
@@ -0,0 +1,325 @@
+#include "Algo/AllOf.h"
+#include "Async/Async.h"
+#include "Misc/AutomationTest.h"
+#include "NBodySimDistributedSolver.h"
+#include "NBodySimSolver.h"
+#include "NBodySimTcpTransport.h"
+#include "NBodySimTransport.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace NBodySimDistributedSolverTests
+{
+	static constexpr uint32 TestFlags = EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter;
+
+	/** Random bodies over the whole screen, moving fast enough to migrate between domains and wrap around. */
+	static FNBodySimParameters MakeParameters(int32 NumBodies)
+	{
+		FRandomStream Random(5);
+
+		FNBodySimParameters Parameters;
+		Parameters.GravityConstant = 1000.0f;
+		Parameters.ViewportWidth = 8000.0f;
+		Parameters.CameraAspectRatio = 1.777778f;
+		Parameters.DeltaTime = 1.0f / 60.0f;
+
+		for (int32 i = 0; i < NumBodies; i++)
+		{
+			const float Mass = Random.FRandRange(20.0f, 50.0f);
+			const float X = Random.FRandRange(-4000.0f, 4000.0f);
+			const float Y = Random.FRandRange(-2250.0f, 2250.0f);
+			const float VelocityX = Random.FRandRange(-600.0f, 600.0f);
+			const float VelocityY = Random.FRandRange(-600.0f, 600.0f);
+			Parameters.Bodies.Emplace(Mass, FVector2f(X, Y), FVector2f(VelocityX, VelocityY));
+		}
+		Parameters.NumBodies = Parameters.Bodies.Num();
+		return Parameters;
+	}
+
+	/** What a rank ended with, its bodies being gathered on rank 0 only. */
+	struct FRankResult
+	{
+		bool bSucceeded = false;
+		int32 NumLocalBodies = 0;
+		int32 NumRemoteSources = 0;
+		TArray<FBodyData> Bodies;
+	};
+
+	/** Run one rank for NumSteps then gather the bodies. Closes the transport on failure, as the commandlet does. */
+	static FRankResult RunRank(const FNBodySimParameters& Parameters, const FNBodySimDistributedOptions& Options, INBodySimTransport& Transport, int32 NumSteps)
+	{
+		FRankResult Result;
+
+		TUniquePtr<FNBodySimDistributedSolver> Solver = FNBodySimDistributedSolver::Create(Parameters, Transport, Options);
+		Result.bSucceeded = Solver && Solver->Step(NumSteps);
+		if (Result.bSucceeded)
+		{
+			Result.NumLocalBodies = Solver->GetNumLocalBodies();
+			Result.NumRemoteSources = Solver->GetNumRemoteSources();
+			Result.bSucceeded = Solver->GatherBodies(Result.Bodies);
+		}
+
+		if (!Result.bSucceeded)
+		{
+			Transport.Close();
+		}
+		return Result;
+	}
+
+	/** Run every rank on its own thread, as they wait on each other. RunRankOnThread gets the rank and returns its result. */
+	static TArray<FRankResult> RunThreads(int32 NumRanks, TFunction<FRankResult(int32 Rank)> RunRankOnThread)
+	{
+		TArray<TFuture<FRankResult>> Futures;
+		for (int32 Rank = 0; Rank < NumRanks; ++Rank)
+		{
+			Futures.Add(Async(EAsyncExecution::Thread, [&RunRankOnThread, Rank]()
+			{
+				return RunRankOnThread(Rank);
+			}));
+		}
+
+		TArray<FRankResult> Results;
+		for (TFuture<FRankResult>& Future : Futures)
+		{
+			Results.Add(Future.Get());
+		}
+		return Results;
+	}
+
+	/** Every rank over the shared memory transport. */
+	static TArray<FRankResult> RunSharedMemoryRanks(const FNBodySimParameters& Parameters, const FNBodySimDistributedOptions& Options, int32 NumRanks, int32 NumSteps)
+	{
+		TArray<TUniquePtr<FNBodySimSharedMemoryTransport>> Transports = FNBodySimSharedMemoryTransport::CreateRanks(NumRanks);
+		return RunThreads(NumRanks, [&](int32 Rank)
+		{
+			return RunRank(Parameters, Options, *Transports[Rank], NumSteps);
+		});
+	}
+
+	static bool AllSucceeded(const TArray<FRankResult>& Results)
+	{
+		return Algo::AllOf(Results, [](const FRankResult& Result) { return Result.bSucceeded; });
+	}
+
+	/** Largest position and velocity differences between Bodies, indexed by id, and the single process Solver. */
+	static void MeasureErrors(const FNBodySimParameters& Parameters, TArrayView<const FBodyData> Bodies, const FNBodySimSolver& Solver, float& OutMaxPositionError, float& OutMaxVelocityError)
+	{
+		// A body on a screen edge may wrap on one side and not on the other, compare across the edge.
+		const FVector2f ScreenSize(Parameters.ViewportWidth, Parameters.ViewportWidth / Parameters.CameraAspectRatio);
+
+		OutMaxPositionError = 0.0f;
+		OutMaxVelocityError = 0.0f;
+		for (int32 Id = 0; Id < Bodies.Num(); Id++)
+		{
+			const int32 Slot = Solver.GetBodySlot(Id);
+			const FVector2f PositionDelta = Bodies[Id].Position - Solver.GetPositions()[Slot];
+			const FVector2f WrappedDelta(
+				FMath::Min(FMath::Abs(PositionDelta.X), ScreenSize.X - FMath::Abs(PositionDelta.X)),
+				FMath::Min(FMath::Abs(PositionDelta.Y), ScreenSize.Y - FMath::Abs(PositionDelta.Y)));
+
+			OutMaxPositionError = FMath::Max(OutMaxPositionError, WrappedDelta.Size());
+			OutMaxVelocityError = FMath::Max(OutMaxVelocityError, (Bodies[Id].Velocity - Solver.GetVelocities()[Slot]).Size());
+		}
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimDistributedSolverMatchesSolverTest, "NBodySim.Distributed.MatchesSolver", NBodySimDistributedSolverTests::TestFlags)
+
+bool FNBodySimDistributedSolverMatchesSolverTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimDistributedSolverTests;
+
+	const int32 NumSteps = 40;
+	const FNBodySimParameters SimParameters = MakeParameters(500);
+
+	// Single process reference, same semi-implicit Euler scheme.
+	TUniquePtr<FNBodySimSolver> Solver = FNBodySimSolver::Create(SimParameters);
+	if (!TestNotNull(TEXT("Solver"), Solver.Get()))
+	{
+		return false;
+	}
+	Solver->Step(NumSteps);
+
+	// Every remote body sent exactly, so only the summation order differs. Rebalance often to move the domains as well.
+	FNBodySimDistributedOptions Options;
+	Options.OpeningAngle = 0.0f;
+	Options.RebalanceInterval = 10;
+	Options.RebalanceThreshold = 1.0f;
+
+	for (int32 NumRanks : { 1, 2, 3, 4 })
+	{
+		const TArray<FRankResult> Results = RunSharedMemoryRanks(SimParameters, Options, NumRanks, NumSteps);
+		if (!TestTrue(FString::Printf(TEXT("%d ranks ran"), NumRanks), AllSucceeded(Results)))
+		{
+			continue;
+		}
+
+		const TArray<FBodyData>& Bodies = Results[0].Bodies;
+		if (!TestEqual(FString::Printf(TEXT("%d ranks body count"), NumRanks), Bodies.Num(), Solver->GetNumBodies()))
+		{
+			continue;
+		}
+
+		for (int32 Id = 0; Id < Bodies.Num(); Id++)
+		{
+			TestEqual(FString::Printf(TEXT("%d ranks mass of body %d"), NumRanks, Id), Bodies[Id].Mass, Solver->GetMasses()[Solver->GetBodySlot(Id)]);
+		}
+
+		float MaxPositionError = 0.0f;
+		float MaxVelocityError = 0.0f;
+		MeasureErrors(SimParameters, Bodies, *Solver, MaxPositionError, MaxVelocityError);
+		TestTrue(FString::Printf(TEXT("%d ranks position error %f under 0.1"), NumRanks, MaxPositionError), MaxPositionError < 0.1f);
+		TestTrue(FString::Printf(TEXT("%d ranks velocity error %f under 0.1"), NumRanks, MaxVelocityError), MaxVelocityError < 0.1f);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimDistributedSolverTreeTest, "NBodySim.Distributed.Tree", NBodySimDistributedSolverTests::TestFlags)
+
+bool FNBodySimDistributedSolverTreeTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimDistributedSolverTests;
+
+	const FNBodySimParameters SimParameters = MakeParameters(500);
+	const FNBodySimDistributedOptions Options;
+
+	// One step first: the velocity change over DeltaTime is the acceleration, so the far field error shows directly.
+	TUniquePtr<FNBodySimSolver> Solver = FNBodySimSolver::Create(SimParameters);
+	if (!TestNotNull(TEXT("Solver"), Solver.Get()))
+	{
+		return false;
+	}
+	Solver->Step();
+
+	for (int32 NumRanks : { 2, 3, 4 })
+	{
+		const TArray<FRankResult> Results = RunSharedMemoryRanks(SimParameters, Options, NumRanks, 1);
+		if (!TestTrue(FString::Printf(TEXT("%d ranks ran"), NumRanks), AllSucceeded(Results)) || !TestEqual(FString::Printf(TEXT("%d ranks body count"), NumRanks), Results[0].Bodies.Num(), Solver->GetNumBodies()))
+		{
+			continue;
+		}
+
+		// Far groups must have been sent as monopoles rather than body by body.
+		int32 NumRemoteBodies = 0;
+		int32 NumRemoteSources = 0;
+		for (const FRankResult& Result : Results)
+		{
+			NumRemoteBodies += Solver->GetNumBodies() - Result.NumLocalBodies;
+			NumRemoteSources += Result.NumRemoteSources;
+		}
+		TestTrue(FString::Printf(TEXT("%d ranks received %d sources for %d remote bodies"), NumRanks, NumRemoteSources, NumRemoteBodies), NumRemoteSources < NumRemoteBodies);
+
+		double SquaredAccelerations = 0.0;
+		double SquaredErrors = 0.0;
+		float MaxError = 0.0f;
+		for (int32 Id = 0; Id < Solver->GetNumBodies(); Id++)
+		{
+			const FVector2f& Velocity = Solver->GetVelocities()[Solver->GetBodySlot(Id)];
+			const FVector2f Acceleration = (Velocity - SimParameters.Bodies[Id].Velocity) / SimParameters.DeltaTime;
+			const float Error = ((Results[0].Bodies[Id].Velocity - Velocity) / SimParameters.DeltaTime).Size();
+
+			SquaredAccelerations += Acceleration.SizeSquared();
+			SquaredErrors += FMath::Square(Error);
+			MaxError = FMath::Max(MaxError, Error);
+		}
+
+		const double RmsAcceleration = FMath::Sqrt(SquaredAccelerations / Solver->GetNumBodies());
+		const double RelativeRmsError = FMath::Sqrt(SquaredErrors / Solver->GetNumBodies()) / RmsAcceleration;
+		TestTrue(FString::Printf(TEXT("%d ranks relative RMS acceleration error %g under 1%%"), NumRanks, RelativeRmsError), RelativeRmsError < 0.01);
+		TestTrue(FString::Printf(TEXT("%d ranks largest acceleration error %f under 10%% of the RMS acceleration %f"), NumRanks, MaxError, RmsAcceleration), MaxError < 0.1 * RmsAcceleration);
+	}
+
+	// Then the error stays bounded over a run, about ten times what summing in another order gives.
+	const int32 NumSteps = 40;
+	Solver = FNBodySimSolver::Create(SimParameters);
+	Solver->Step(NumSteps);
+
+	for (int32 NumRanks : { 2, 4 })
+	{
+		const TArray<FRankResult> Results = RunSharedMemoryRanks(SimParameters, Options, NumRanks, NumSteps);
+		if (!TestTrue(FString::Printf(TEXT("%d ranks ran %d steps"), NumRanks, NumSteps), AllSucceeded(Results)) || !TestEqual(FString::Printf(TEXT("%d ranks body count after %d steps"), NumRanks, NumSteps), Results[0].Bodies.Num(), Solver->GetNumBodies()))
+		{
+			continue;
+		}
+
+		float MaxPositionError = 0.0f;
+		float MaxVelocityError = 0.0f;
+		MeasureErrors(SimParameters, Results[0].Bodies, *Solver, MaxPositionError, MaxVelocityError);
+		TestTrue(FString::Printf(TEXT("%d ranks position error %f under 1"), NumRanks, MaxPositionError), MaxPositionError < 1.0f);
+		TestTrue(FString::Printf(TEXT("%d ranks velocity error %f under 1"), NumRanks, MaxVelocityError), MaxVelocityError < 1.0f);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimDistributedSolverTcpTest, "NBodySim.Distributed.Tcp", NBodySimDistributedSolverTests::TestFlags)
+
+bool FNBodySimDistributedSolverTcpTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimDistributedSolverTests;
+
+	const int32 NumSteps = 20;
+	const FNBodySimParameters SimParameters = MakeParameters(500);
+
+	// Domains rebalanced from measured times would differ from one run to the other.
+	FNBodySimDistributedOptions Options;
+	Options.RebalanceInterval = 0;
+
+	const TArray<FRankResult> Expected = RunSharedMemoryRanks(SimParameters, Options, 2, NumSteps);
+	if (!TestTrue(TEXT("Shared memory ranks ran"), AllSucceeded(Expected)))
+	{
+		return false;
+	}
+
+	// Two processes on loopback, as threads of this one. A random port range avoids clashing with a previous run.
+	const int32 BasePort = FMath::RandRange(20000, 60000);
+	const TArray<FString> Endpoints = { FString::Printf(TEXT("127.0.0.1:%d"), BasePort), FString::Printf(TEXT("127.0.0.1:%d"), BasePort + 1) };
+
+	const TArray<FRankResult> Results = RunThreads(Endpoints.Num(), [&](int32 Rank)
+	{
+		TUniquePtr<FNBodySimTcpTransport> Transport = FNBodySimTcpTransport::Create(Rank, Endpoints, 10.0f);
+		return Transport ? RunRank(SimParameters, Options, *Transport, NumSteps) : FRankResult();
+	});
+
+	if (!TestTrue(TEXT("TCP ranks ran"), AllSucceeded(Results)) || !TestEqual(TEXT("Body count"), Results[0].Bodies.Num(), Expected[0].Bodies.Num()))
+	{
+		return false;
+	}
+
+	// Same messages in the same order, the results are the same bits.
+	TestTrue(TEXT("Same bodies as the shared memory transport"), FMemory::Memcmp(Results[0].Bodies.GetData(), Expected[0].Bodies.GetData(), Expected[0].Bodies.Num() * sizeof(FBodyData)) == 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNBodySimDistributedSolverFailedRankTest, "NBodySim.Distributed.FailedRank", NBodySimDistributedSolverTests::TestFlags)
+
+bool FNBodySimDistributedSolverFailedRankTest::RunTest(const FString& Parameters)
+{
+	using namespace NBodySimDistributedSolverTests;
+
+	const FNBodySimParameters SimParameters = MakeParameters(300);
+	const FNBodySimDistributedOptions Options;
+
+	// Rank 1 gives up after a few steps, the others must stop instead of waiting for it forever.
+	AddExpectedError(TEXT("lost another rank"), EAutomationExpectedErrorFlags::Contains, 0);
+
+	TArray<TUniquePtr<FNBodySimSharedMemoryTransport>> Transports = FNBodySimSharedMemoryTransport::CreateRanks(3);
+	const TArray<FRankResult> Results = RunThreads(Transports.Num(), [&](int32 Rank)
+	{
+		if (Rank == 1)
+		{
+			TUniquePtr<FNBodySimDistributedSolver> Solver = FNBodySimDistributedSolver::Create(SimParameters, *Transports[Rank], Options);
+			Solver->Step(5);
+			Transports[Rank]->Close();
+			return FRankResult();
+		}
+		return RunRank(SimParameters, Options, *Transports[Rank], 20);
+	});
+
+	for (int32 Rank = 0; Rank < Results.Num(); Rank++)
+	{
+		TestFalse(FString::Printf(TEXT("Rank %d failed"), Rank), Results[Rank].bSucceeded);
+	}
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
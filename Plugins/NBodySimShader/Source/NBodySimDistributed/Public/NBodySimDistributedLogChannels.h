@@ -0,0 +1,6 @@
+#pragma once
+
+#include "Containers/UnrealString.h"
+#include "Logging/LogMacros.h"
+
+NBODYSIMDISTRIBUTED_API DECLARE_LOG_CATEGORY_EXTERN(LogNBodySimDistributed, Log, All);
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NBodySimDomainDecomposition.h"
+#include "NBodySimTypesDefinitions.h"
+
+class INBodySimTransport;
+
+/**
+ *	Settings of the distributed solver.
+ */
+struct FNBodySimDistributedOptions
+{
+	/**
+	 *	Opening angle of the tree walk deciding what other ranks receive: a group of bodies smaller than
+	 *	OpeningAngle times its distance to a domain is sent as a single monopole, otherwise body by body.
+	 *	0 sends every body exactly.
+	 */
+	float OpeningAngle = 0.5f;
+
+	/** Maximum number of bodies in a leaf of the local tree. */
+	int32 MaxLeafBodies = 16;
+
+	/** Check the load balance every RebalanceInterval steps, 0 to keep the initial domains. */
+	int32 RebalanceInterval = 50;
+
+	/** Rebalance when the slowest rank spent more than RebalanceThreshold times the average force computation time. */
+	float RebalanceThreshold = 1.1f;
+
+	/** Positions each rank contributes to rebuilding the domains. */
+	int32 MaxBalanceSamplesPerRank = 4096;
+};
+
+/**
+ *	N-Body solver spread over several ranks, each owning the bodies of one domain of an orthogonal recursive bisection.
+ *
+ *	Every step, each rank sends every other rank the sources acting on its domain: nearby bodies exactly, as ghosts,
+ *	and far groups of bodies as monopoles from a walk of its local tree, i.e. a locally essential tree.
+ *	Forces between bodies of the same domain are summed directly with the kernels of the headless solver.
+ *	Bodies leaving their domain migrate to their new owner, and domains are rebuilt from each rank's
+ *	measured force computation time when the load becomes unbalanced.
+ *
+ *	Step, Rebalance and GatherBodies are collective: every rank must call them in the same order.
+ */
+class NBODYSIMDISTRIBUTED_API FNBodySimDistributedSolver
+{
+public:
+	/**
+	 *	Every rank calls it with the same parameters and keeps the bodies of its own domain.
+	 *	Transport must outlive the solver. Returns null if the parameters are invalid.
+	 */
+	static TUniquePtr<FNBodySimDistributedSolver> Create(const FNBodySimParameters& Parameters, INBodySimTransport& Transport, const FNBodySimDistributedOptions& Options = FNBodySimDistributedOptions());
+
+	/** Advance the simulation by NumSteps. Returns false if another rank went away. */
+	bool Step(int32 NumSteps = 1);
+
+	/** Rebuild the domains from the force computation time of each rank since the last rebalance, if unbalanced. */
+	bool Rebalance(bool bForce = false);
+
+	/** Every body on rank 0, ordered by id, i.e. by index in the initial parameters. Other ranks get an empty array. */
+	bool GatherBodies(TArray<FBodyData>& OutBodies);
+
+	int32 GetRank() const;
+	uint64 GetStepCount() const { return StepCount; }
+	const FNBodySimDomainDecomposition& GetDomains() const { return Domains; }
+
+	/** Bodies currently owned by this rank. */
+	int32 GetNumLocalBodies() const { return Masses.Num(); }
+	TArrayView<const float> GetMasses() const { return Masses; }
+	TArrayView<const FVector2f> GetPositions() const { return Positions; }
+	TArrayView<const FVector2f> GetVelocities() const { return Velocities; }
+	TArrayView<const int32> GetBodyIds() const { return BodyIds; }
+
+	/** Sources received from other ranks at the last step. */
+	int32 GetNumRemoteSources() const { return SourceMasses.Num(); }
+
+private:
+	FNBodySimDistributedSolver(const FNBodySimParameters& Parameters, INBodySimTransport& InTransport, const FNBodySimDistributedOptions& InOptions);
+
+	/** Build the local tree and exchange the sources acting on each domain. */
+	bool ExchangeSources();
+
+	/** Accelerations of the local bodies from the local bodies and the received sources. */
+	void ComputeAccelerations();
+
+	/** Semi-implicit Euler, same scheme as the compute shader. */
+	void Integrate();
+
+	/** Send the bodies outside of this rank's domain to their owner and receive the ones entering it. */
+	bool MigrateBodies();
+
+	void BuildTree();
+	int32 BuildTreeNode(const FBox2f& Bounds, int32 FirstBody, int32 NumBodies, int32 Depth);
+
+	/** Append the sources of the subtree at NodeIndex acting on a body inside Target. */
+	void AppendSources(int32 NodeIndex, const FBox2f& Target, TArray<float>& OutMasses, TArray<FVector2f>& OutPositions) const;
+
+	void RemoveLocalBody(int32 Index);
+	void AddLocalBody(float Mass, const FVector2f& Position, const FVector2f& Velocity, int32 BodyId);
+
+private:
+	struct FTreeNode
+	{
+		FBox2f Bounds = FBox2f(ForceInit);
+		FVector2f CenterOfMass = FVector2f::ZeroVector;
+		float Mass = 0.0f;
+
+		/** Bodies [FirstBody, FirstBody + NumBodies) of TreeBodies. */
+		int32 FirstBody = 0;
+		int32 NumBodies = 0;
+
+		/** INDEX_NONE for a leaf. */
+		int32 Children[4] = { INDEX_NONE, INDEX_NONE, INDEX_NONE, INDEX_NONE };
+	};
+
+	INBodySimTransport& Transport;
+	FNBodySimDistributedOptions Options;
+
+	float GravityConstant;
+	float CameraAspectRatio;
+	float ViewportWidth;
+	float DeltaTime;
+
+	/** Whole simulation area, split between ranks. */
+	FBox2f ScreenBounds;
+
+	FNBodySimDomainDecomposition Domains;
+
+	TArray<float> Masses;
+	TArray<FVector2f> Positions;
+	TArray<FVector2f> Velocities;
+	TArray<FVector2f> Accelerations;
+	TArray<int32> BodyIds;
+
+	/** Ghost bodies and monopoles received from the other ranks. */
+	TArray<float> SourceMasses;
+	TArray<FVector2f> SourcePositions;
+
+	/** Local tree over the local bodies, rebuilt every step. */
+	TArray<FTreeNode> TreeNodes;
+	TArray<int32> TreeBodies;
+
+	/** Force computation time and steps since the last rebalance, the load measure of this rank. */
+	double ComputeSeconds = 0.0;
+	int32 ComputeSteps = 0;
+
+	uint64 StepCount = 0;
+};
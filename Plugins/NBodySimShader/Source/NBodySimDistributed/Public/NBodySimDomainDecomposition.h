@@ -0,0 +1,47 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ *	Orthogonal recursive bisection of the simulation area into one rectangular domain per rank.
+ *	Each split cuts the longest side of its box so both halves carry a weight proportional to
+ *	the number of domains they will hold, the weight of a body being its estimated force cost.
+ *
+ *	Building is deterministic: every rank builds the same tree from the same gathered samples.
+ */
+class NBODYSIMDISTRIBUTED_API FNBodySimDomainDecomposition
+{
+public:
+	/**
+	 *	Split Bounds into NumDomains domains.
+	 *	@param Points	Sample positions the domains are balanced on, every body or a subset.
+	 *	@param Weights	Cost of each sample, empty to weight them all the same.
+	 */
+	void Build(const FBox2f& Bounds, TArrayView<const FVector2f> Points, TArrayView<const float> Weights, int32 NumDomains);
+
+	int32 GetNumDomains() const { return DomainBounds.Num(); }
+
+	/** Domain owning Position. Positions outside the bounds go to the nearest domain along each split. */
+	int32 FindDomain(const FVector2f& Position) const;
+
+	const FBox2f& GetDomainBounds(int32 Domain) const { return DomainBounds[Domain]; }
+
+private:
+	struct FNode
+	{
+		/** Domain of a leaf, INDEX_NONE for a split. */
+		int32 Domain = INDEX_NONE;
+
+		/** Positions with Position[Axis] < Split go to the first child. */
+		int32 Axis = 0;
+		float Split = 0.0f;
+		int32 Children[2] = { INDEX_NONE, INDEX_NONE };
+	};
+
+	/** Build the subtree splitting Bounds into the domains [FirstDomain, FirstDomain + NumDomains) over the samples Indices. */
+	int32 BuildNode(const FBox2f& Bounds, TArrayView<int32> Indices, int32 FirstDomain, int32 NumDomains, TArrayView<const FVector2f> Points, TArrayView<const float> Weights);
+
+private:
+	TArray<FNode> Nodes;
+	TArray<FBox2f> DomainBounds;
+};
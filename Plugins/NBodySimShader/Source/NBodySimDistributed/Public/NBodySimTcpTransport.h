@@ -0,0 +1,56 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NBodySimTransport.h"
+
+class FSocket;
+class FRunnableThread;
+
+/**
+ *	Transport between processes, possibly on different hosts, over a full mesh of TCP connections.
+ *	Every peer has a receiving thread draining its socket, so sends never wait on a busy receiver.
+ */
+class NBODYSIMDISTRIBUTED_API FNBodySimTcpTransport : public INBodySimTransport
+{
+public:
+	/**
+	 *	Listen on this rank's endpoint and connect to every other rank, blocking until the mesh is complete.
+	 *	@param Rank				This process' rank, its index in Endpoints.
+	 *	@param Endpoints		"ip:port" of every rank, the same list on every process.
+	 *	@param TimeoutSeconds	Maximum time to wait for the other ranks to show up.
+	 *	@return Null if the mesh could not be established in time.
+	 */
+	static TUniquePtr<FNBodySimTcpTransport> Create(int32 Rank, const TArray<FString>& Endpoints, float TimeoutSeconds = 30.0f);
+
+	/** Largest message sent or accepted, a bigger frame size read from a socket means a corrupt or foreign stream. */
+	static constexpr int32 MaxMessageSize = 64 * 1024 * 1024;
+
+	virtual ~FNBodySimTcpTransport() override;
+
+	virtual int32 GetRank() const override { return Rank; }
+	virtual int32 GetNumRanks() const override { return Peers.Num(); }
+
+	virtual void Send(int32 ToRank, TArray<uint8>&& Message) override;
+	virtual bool Receive(int32 FromRank, TArray<uint8>& OutMessage) override;
+	virtual void Close() override;
+
+private:
+	struct FPeer;
+
+	explicit FNBodySimTcpTransport(int32 InRank, int32 NumRanks);
+
+	/** Start the receiving thread of every connected peer. */
+	void StartReceiving();
+
+	/** Read exactly Size bytes from Socket, giving up at Deadline (in FPlatformTime::Seconds()) unless it is 0. */
+	static bool ReceiveAll(FSocket* Socket, uint8* Data, int32 Size, double Deadline = 0.0);
+
+	/** Write exactly Size bytes to Socket. */
+	static bool SendAll(FSocket* Socket, const uint8* Data, int32 Size);
+
+private:
+	int32 Rank;
+
+	/** Indexed by rank, own entry unused. */
+	TArray<TUniquePtr<FPeer>> Peers;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "HAL/Event.h"
+#include <atomic>
+
+/**
+ *	Message passing between the ranks of a distributed simulation.
+ *	Messages between two given ranks arrive in the order they were sent.
+ */
+class NBODYSIMDISTRIBUTED_API INBodySimTransport
+{
+public:
+	virtual ~INBodySimTransport() = default;
+
+	virtual int32 GetRank() const = 0;
+	virtual int32 GetNumRanks() const = 0;
+
+	/** Queue Message for another rank. Never waits for the receiver to read it. */
+	virtual void Send(int32 ToRank, TArray<uint8>&& Message) = 0;
+
+	/** Wait for the next message from another rank. Returns false if that rank is gone. */
+	virtual bool Receive(int32 FromRank, TArray<uint8>& OutMessage) = 0;
+
+	/**
+	 *	Leave the simulation, e.g. after this rank failed, so no other rank waits on it forever.
+	 *	Their Receive from this rank returns false once the messages sent before are read.
+	 */
+	virtual void Close() = 0;
+
+	/** Send Payload to every other rank and receive theirs. OutPayloads is indexed by rank, own payload included. */
+	bool AllGather(const TArray<uint8>& Payload, TArray<TArray<uint8>>& OutPayloads);
+
+	/** Send Outgoing[Rank] to each other rank and receive what each one sent. Outgoing[GetRank()] is kept as is. */
+	bool AllToAll(TArray<TArray<uint8>>&& Outgoing, TArray<TArray<uint8>>& OutIncoming);
+};
+
+/**
+ *	Shared state of the ranks of a single process, one mailbox per pair of ranks.
+ */
+class NBODYSIMDISTRIBUTED_API FNBodySimSharedMemoryHub
+{
+public:
+	explicit FNBodySimSharedMemoryHub(int32 InNumRanks);
+	~FNBodySimSharedMemoryHub();
+
+	int32 GetNumRanks() const { return NumRanks; }
+
+	void Post(int32 FromRank, int32 ToRank, TArray<uint8>&& Message);
+
+	/** Wait for the next message of FromRank to ToRank. Returns false once FromRank is closed and its messages are read. */
+	bool Wait(int32 FromRank, int32 ToRank, TArray<uint8>& OutMessage);
+
+	/** Mark Rank as gone and wake up every rank waiting on it. */
+	void Close(int32 Rank);
+
+private:
+	struct FMailbox
+	{
+		/** A single sender and a single receiver per mailbox. */
+		TQueue<TArray<uint8>, EQueueMode::Spsc> Messages;
+		FEvent* MessageEvent = nullptr;
+
+		/** Set once the sending rank is closed, no message is posted after. */
+		std::atomic<bool> bSenderClosed { false };
+	};
+
+	FMailbox& GetMailbox(int32 FromRank, int32 ToRank) { return *Mailboxes[FromRank * NumRanks + ToRank]; }
+
+	int32 NumRanks;
+	TArray<TUniquePtr<FMailbox>> Mailboxes;
+};
+
+/**
+ *	Transport between ranks running as threads of the same process, through shared memory.
+ *	Mostly useful to run and debug a decomposed simulation without any network.
+ */
+class NBODYSIMDISTRIBUTED_API FNBodySimSharedMemoryTransport : public INBodySimTransport
+{
+public:
+	/** One transport per rank, all sharing the same hub. */
+	static TArray<TUniquePtr<FNBodySimSharedMemoryTransport>> CreateRanks(int32 NumRanks);
+
+	FNBodySimSharedMemoryTransport(TSharedRef<FNBodySimSharedMemoryHub> InHub, int32 InRank);
+	virtual ~FNBodySimSharedMemoryTransport() override;
+
+	virtual int32 GetRank() const override { return Rank; }
+	virtual int32 GetNumRanks() const override { return Hub->GetNumRanks(); }
+
+	virtual void Send(int32 ToRank, TArray<uint8>&& Message) override;
+	virtual bool Receive(int32 FromRank, TArray<uint8>& OutMessage) override;
+	virtual void Close() override;
+
+private:
+	TSharedRef<FNBodySimSharedMemoryHub> Hub;
+	int32 Rank;
+};
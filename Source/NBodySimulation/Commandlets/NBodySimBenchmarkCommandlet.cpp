@@ -0,0 +1,109 @@
+﻿#include "NBodySimBenchmarkCommandlet.h"
+
+#include "NBodySimSolver.h"
+#include "SimulationLogChannels.h"
+
+/** Cost of the deterministic mode over the fast one above which the benchmark warns, in percent. */
+static constexpr double MaxDeterministicOverhead = 15.0;
+
+UNBodySimBenchmarkCommandlet::UNBodySimBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UNBodySimBenchmarkCommandlet::Main(const FString& Params)
+{
+	FString BodyCountList = TEXT("1024,4096,16384");
+	FParse::Value(*Params, TEXT("Bodies="), BodyCountList, false);
+
+	int32 NumSteps = 20;
+	FParse::Value(*Params, TEXT("Steps="), NumSteps);
+	NumSteps = FMath::Max(NumSteps, 1);
+
+	FNBodySimSolverOptions Options;
+
+	FString IntegratorName;
+	if (FParse::Value(*Params, TEXT("Integrator="), IntegratorName))
+	{
+		if (IntegratorName == TEXT("Leapfrog"))
+		{
+			Options.Integrator = ENBodySimIntegrator::Leapfrog;
+		}
+		else if (IntegratorName == TEXT("BlockTimesteps"))
+		{
+			Options.Integrator = ENBodySimIntegrator::BlockTimesteps;
+		}
+		else if (IntegratorName != TEXT("SemiImplicitEuler"))
+		{
+			UE_LOG(LogNBodySimulation, Error, TEXT("Unknown integrator '%s', expected SemiImplicitEuler, Leapfrog or BlockTimesteps."), *IntegratorName);
+			return 1;
+		}
+	}
+
+	TArray<FString> BodyCounts;
+	BodyCountList.ParseIntoArray(BodyCounts, TEXT(","));
+
+	for (const FString& BodyCount : BodyCounts)
+	{
+		const int32 NumBodies = FCString::Atoi(*BodyCount);
+		if (NumBodies <= 0)
+		{
+			UE_LOG(LogNBodySimulation, Error, TEXT("Invalid body count '%s'."), *BodyCount);
+			return 1;
+		}
+
+		Options.bDeterministic = false;
+		const double MsPerStep = TimeSteps(NumBodies, NumSteps, Options);
+
+		Options.bDeterministic = true;
+		const double DeterministicMsPerStep = TimeSteps(NumBodies, NumSteps, Options);
+
+		// Pairwise interactions per second, the usual throughput measure of a direct sum.
+		const double Interactions = static_cast<double>(NumBodies) * (NumBodies - 1);
+		const double DeterministicOverhead = (DeterministicMsPerStep / MsPerStep - 1.0) * 100.0;
+
+		UE_LOG(LogNBodySimulation, Display, TEXT("%6d bodies : %9.3f ms/step, %7.1f M interactions/s, deterministic %9.3f ms/step (%+.1f%%)."),
+			NumBodies, MsPerStep, Interactions / (MsPerStep * 1000.0), DeterministicMsPerStep, DeterministicOverhead);
+
+		if (DeterministicOverhead > MaxDeterministicOverhead)
+		{
+			UE_LOG(LogNBodySimulation, Warning, TEXT("%d bodies : deterministic mode costs more than %.0f%% over the fast mode."), NumBodies, MaxDeterministicOverhead);
+		}
+	}
+
+	return 0;
+}
+
+double UNBodySimBenchmarkCommandlet::TimeSteps(int32 NumBodies, int32 NumSteps, const FNBodySimSolverOptions& Options)
+{
+	// Bodies spread over the screen, from a fixed seed so runs compare.
+	FRandomStream Random(NumBodies);
+
+	FNBodySimParameters Parameters;
+	Parameters.NumBodies = NumBodies;
+	Parameters.GravityConstant = 1000.0f;
+	Parameters.ViewportWidth = 100000.0f;
+	Parameters.CameraAspectRatio = 16.0f / 9.0f;
+	Parameters.DeltaTime = 1.0f / 60.0f;
+
+	for (int32 i = 0; i < NumBodies; i++)
+	{
+		const float Mass = Random.FRandRange(20.0f, 100.0f);
+		const float X = Random.FRandRange(-20000.0f, 20000.0f);
+		const float Y = Random.FRandRange(-20000.0f, 20000.0f);
+		Parameters.Bodies.Emplace(Mass, FVector2f(X, Y), FVector2f::ZeroVector);
+	}
+
+	TUniquePtr<FNBodySimSolver> Solver = FNBodySimSolver::Create(Parameters, Options);
+	check(Solver);
+
+	// Leaves out the first step, which also fills the leapfrog and timestep level caches.
+	Solver->Step();
+
+	const double StartTime = FPlatformTime::Seconds();
+	Solver->Step(NumSteps);
+	return (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumSteps;
+}
@@ -0,0 +1,26 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "NBodySimBenchmarkCommandlet.generated.h"
+
+struct FNBodySimSolverOptions;
+
+/**
+ *	Times the headless CPU solver at several body counts, in fast and deterministic mode, no renderer nor GPU needed:
+ *		-run=NBodySimBenchmark -nullrhi -Bodies=1024,4096,16384 -Steps=20 -Integrator=Leapfrog
+ */
+UCLASS()
+class UNBodySimBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UNBodySimBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	// Average milliseconds per Step() of NumBodies random bodies, after a warm-up step.
+	static double TimeSteps(int32 NumBodies, int32 NumSteps, const FNBodySimSolverOptions& Options);
+};
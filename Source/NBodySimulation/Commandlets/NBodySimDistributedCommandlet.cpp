@@ -0,0 +1,135 @@
+﻿#include "NBodySimDistributedCommandlet.h"
+
+#include "Async/Async.h"
+#include "Config/SimulationConfig.h"
+#include "Misc/Crc.h"
+#include "NBodySimDistributedSolver.h"
+#include "NBodySimTcpTransport.h"
+#include "NBodySimTransport.h"
+#include "SimulationLogChannels.h"
+
+UNBodySimDistributedCommandlet::UNBodySimDistributedCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UNBodySimDistributedCommandlet::Main(const FString& Params)
+{
+	FString ConfigPath;
+	if (!FParse::Value(*Params, TEXT("Config="), ConfigPath))
+	{
+		UE_LOG(LogNBodySimulation, Error, TEXT("Missing -Config=<SimulationConfig asset path>."));
+		return 1;
+	}
+
+	const USimulationConfig* SimulationConfig = LoadObject<USimulationConfig>(nullptr, *ConfigPath);
+	if (!SimulationConfig)
+	{
+		UE_LOG(LogNBodySimulation, Error, TEXT("Failed to load SimulationConfig '%s'."), *ConfigPath);
+		return 1;
+	}
+
+	int32 NumSteps = 1000;
+	float DeltaTime = SimulationConfig->FixedDeltaTime;
+	FParse::Value(*Params, TEXT("Steps="), NumSteps);
+	FParse::Value(*Params, TEXT("DeltaTime="), DeltaTime);
+
+	// Every rank, in every process, must start from the same bodies.
+	FNBodySimParameters Parameters;
+	SimulationConfig->GenerateBodies(Parameters.Bodies, true);
+	Parameters.NumBodies = Parameters.Bodies.Num();
+	Parameters.GravityConstant = SimulationConfig->GravitationalConstant;
+	Parameters.CameraAspectRatio = SimulationConfig->CameraAspectRatio;
+	Parameters.ViewportWidth = SimulationConfig->CameraOrthoWidth;
+	Parameters.DeltaTime = DeltaTime;
+
+	FString EndpointList;
+	if (FParse::Value(*Params, TEXT("Endpoints="), EndpointList, false))
+	{
+		int32 Rank = 0;
+		FParse::Value(*Params, TEXT("Rank="), Rank);
+
+		TArray<FString> Endpoints;
+		EndpointList.ParseIntoArray(Endpoints, TEXT(","));
+
+		TUniquePtr<FNBodySimTcpTransport> Transport = FNBodySimTcpTransport::Create(Rank, Endpoints);
+		if (!Transport)
+		{
+			return 1;
+		}
+		return RunRank(Parameters, *Transport, NumSteps) ? 0 : 1;
+	}
+
+	int32 NumRanks = 1;
+	FParse::Value(*Params, TEXT("Ranks="), NumRanks);
+	NumRanks = FMath::Max(NumRanks, 1);
+
+	// Ranks wait on each other, each needs its own thread rather than a task.
+	TArray<TUniquePtr<FNBodySimSharedMemoryTransport>> Transports = FNBodySimSharedMemoryTransport::CreateRanks(NumRanks);
+	TArray<TFuture<bool>> Results;
+	for (TUniquePtr<FNBodySimSharedMemoryTransport>& Transport : Transports)
+	{
+		INBodySimTransport* RankTransport = Transport.Get();
+		Results.Add(Async(EAsyncExecution::Thread, [&Parameters, RankTransport, NumSteps]()
+		{
+			// A failed rank must not leave the others waiting for its messages.
+			const bool bRankSucceeded = RunRank(Parameters, *RankTransport, NumSteps);
+			if (!bRankSucceeded)
+			{
+				RankTransport->Close();
+			}
+			return bRankSucceeded;
+		}));
+	}
+
+	bool bSucceeded = true;
+	for (TFuture<bool>& Result : Results)
+	{
+		bSucceeded &= Result.Get();
+	}
+	return bSucceeded ? 0 : 1;
+}
+
+bool UNBodySimDistributedCommandlet::RunRank(const FNBodySimParameters& Parameters, INBodySimTransport& Transport, int32 NumSteps)
+{
+	TUniquePtr<FNBodySimDistributedSolver> Solver = FNBodySimDistributedSolver::Create(Parameters, Transport);
+	if (!Solver)
+	{
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	constexpr int32 ReportInterval = 100;
+
+	for (int32 Step = 0; Step < NumSteps; Step += ReportInterval)
+	{
+		const int32 NumBatchSteps = FMath::Min(ReportInterval, NumSteps - Step);
+		const double BatchStartTime = FPlatformTime::Seconds();
+
+		if (!Solver->Step(NumBatchSteps))
+		{
+			return false;
+		}
+
+		UE_LOG(LogNBodySimulation, Display, TEXT("Rank %d step %llu : %.3f ms/step, %d bodies, %d remote sources."),
+			Solver->GetRank(), Solver->GetStepCount(), (FPlatformTime::Seconds() - BatchStartTime) * 1000.0 / NumBatchSteps,
+			Solver->GetNumLocalBodies(), Solver->GetNumRemoteSources());
+	}
+
+	TArray<FBodyData> Bodies;
+	if (!Solver->GatherBodies(Bodies))
+	{
+		return false;
+	}
+
+	if (Solver->GetRank() == 0)
+	{
+		UE_LOG(LogNBodySimulation, Display, TEXT("Simulated %d bodies over %d ranks for %d steps in %.2f s, final state hash %08x."),
+			Bodies.Num(), Transport.GetNumRanks(), NumSteps, FPlatformTime::Seconds() - StartTime,
+			FCrc::MemCrc32(Bodies.GetData(), Bodies.Num() * sizeof(FBodyData)));
+	}
+	return true;
+}
@@ -0,0 +1,32 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "NBodySimDistributedCommandlet.generated.h"
+
+class INBodySimTransport;
+struct FNBodySimParameters;
+
+/**
+ *	Runs a simulation config headless, spread over several ranks with the distributed solver.
+ *
+ *	In a single process, ranks as threads talking through shared memory:
+ *		-run=NBodySimDistributed -Config=/Game/Path/To/Config -Ranks=4 -Steps=1000
+ *
+ *	In one process per rank, over TCP, with the same endpoint list on every process:
+ *		-run=NBodySimDistributed -Config=/Game/Path/To/Config -Rank=0 -Endpoints=127.0.0.1:7000,127.0.0.1:7001 -Steps=1000
+ */
+UCLASS()
+class UNBodySimDistributedCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UNBodySimDistributedCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	// Simulate NumSteps on one rank, then gather the bodies on rank 0.
+	static bool RunRank(const FNBodySimParameters& Parameters, INBodySimTransport& Transport, int32 NumSteps);
+};
@@ -2,3 +2,61 @@
 
 
 #include "SimulationConfig.h"
+
+void USimulationConfig::GenerateBodies(TArray<FBodyData>& OutBodies, bool bFromSeed) const
+{
+	OutBodies.SetNumUninitialized(NumberOfBody + CustomBodies.Num());
+
+	// Initialize the random Bodies with a default random position, velocity and mass depending on config.
+	for (int32 Index = 0; Index < NumberOfBody; ++Index)
+	{
+		/**
+		 *	When seeded each body draws from its own stream seeded from its index,
+		 *	so spawning neither depends on the global RNG state nor on what was spawned before.
+		 */
+		FRandomStream BodyStream(static_cast<int32>(HashCombine(GetTypeHash(RandomSeed), GetTypeHash(Index))));
+		auto RandRange = [&BodyStream, bFromSeed](float Min, float Max)
+		{
+			return bFromSeed ? BodyStream.FRandRange(Min, Max) : FMath::FRandRange(Min, Max);
+		};
+
+		float RandomMass = RandRange(InitialBodyMassRange.X, InitialBodyMassRange.Y);
+
+		FVector2f RandomPosition = bFromSeed
+			? RandPointInCircle(BodyStream, BodySpawnCircleRadius)
+			: FVector2f(FMath::RandPointInCircle(BodySpawnCircleRadius));
+
+		/**
+		 *	For the velocity, we need to have a starting velocity for each body so that they are rotating into the circle clockwise.
+		 *	This allow to have a nice starting movement.
+		 *	With 0 starting velocity, we kind of have a Supernova.
+		 *	RadialSpeedRate, once applied, allow to give bodies less velocity when spawning near center (0,0) and more and more near the edge of the spawning circle.
+		 */
+		float RadialSpeedRate = BodySpawnCircleRadius / RandomPosition.Size();
+		FVector2f RandomVelocity
+		{
+			RandRange(BodySpawnVelocityRange.X, BodySpawnVelocityRange.Y) / RadialSpeedRate,
+			0
+		};
+		/** Trigonometry to rotate velocity in a clockwise movement in the circle. */
+		RandomVelocity = RandomVelocity.GetRotated(90.0f + FMath::RadiansToDegrees(FMath::Atan2(RandomPosition.Y, RandomPosition.X)));
+
+		OutBodies[Index] = FBodyData(RandomMass, RandomPosition, RandomVelocity);
+	}
+
+	// Initialize the additional bodies set in the config file.
+	for (int32 Index = 0; Index < CustomBodies.Num(); ++Index)
+	{
+		const FBodyConfigEntry& CustomBodyEntry = CustomBodies[Index];
+		OutBodies[NumberOfBody + Index] = FBodyData(CustomBodyEntry.Mass, CustomBodyEntry.SpawnPosition, CustomBodyEntry.SpawnVelocity);
+	}
+}
+
+FVector2f USimulationConfig::RandPointInCircle(const FRandomStream& Stream, float CircleRadius)
+{
+	// Same distribution as FMath::RandPointInCircle, drawn from the given stream.
+	const float Radius = CircleRadius * FMath::Sqrt(Stream.FRand());
+	const float Angle = Stream.FRandRange(0.0f, UE_TWO_PI);
+
+	return FVector2f(Radius * FMath::Cos(Angle), Radius * FMath::Sin(Angle));
+}
@@ -4,8 +4,33 @@
 
 #include "CoreMinimal.h"
 #include "UObject/Object.h"
+#include "Math/RandomStream.h"
+#include "NBodySimTypesDefinitions.h"
 #include "SimulationConfig.generated.h"
 
+/**
+ *	Hardware on which the simulation runs.
+ */
+UENUM(BlueprintType)
+enum class ESimulationBackend : uint8
+{
+	/** Compute shader dispatched every frame from the renderer. */
+	GPU,
+
+	/** Headless solver advanced from the actor's tick with ParallelFor. */
+	CPU
+};
+
+/**
+ *	Space-filling curve used to reorder bodies in memory.
+ */
+UENUM(BlueprintType)
+enum class EBodyReorderCurve : uint8
+{
+	Morton,
+	Hilbert
+};
+
 USTRUCT(BlueprintType)
 struct FBodyConfigEntry
 {
@@ -56,6 +81,72 @@ public:
 
 
 	
+	/** Where the simulation is computed. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="WorldSettings")
+	ESimulationBackend Backend = ESimulationBackend::GPU;
+
+	/**
+	 *	Bit-reproducible runs for regression testing and replay: bodies spawn from RandomSeed and the
+	 *	simulation runs on the CPU backend with FixedDeltaTime steps.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="WorldSettings")
+	bool bDeterministic = false;
+
+	/** Seed of the bodies' spawn in deterministic mode. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="WorldSettings", meta = (EditCondition = "bDeterministic"))
+	int32 RandomSeed = 0;
+
+	/** In deterministic mode, log a hash of the simulation state every this many steps. 0 to disable. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="WorldSettings", meta = (EditCondition = "bDeterministic", ClampMin = 0))
+	int32 StateHashInterval = 0;
+
+	/**
+	 *	Time step of deterministic and replayed runs, which cannot follow the frame rate to be reproducible.
+	 *	The simulation advances one step per frame.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="WorldSettings", meta = (EditCondition = "bDeterministic || bEnableReplay", ClampMin = 0.0001f))
+	float FixedDeltaTime = 1.0f / 60.0f;
+
+	/**
+	 *	Record keyframes so the run can be scrubbed back and forth. Runs on the CPU backend
+	 *	with the time reversible leapfrog integrator and FixedDeltaTime steps.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Replay")
+	bool bEnableReplay = false;
+
+	/** Number of simulation steps between two replay keyframes. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Replay", meta = (EditCondition = "bEnableReplay", ClampMin = 1))
+	int32 ReplayKeyframeInterval = 60;
+
+	/** Maximum memory used by the replay keyframes, in megabytes. Oldest keyframes are dropped first. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Replay", meta = (EditCondition = "bEnableReplay", ClampMin = 1))
+	int32 ReplayMemoryBudgetMB = 256;
+
+	/** Maintain a spatial index of the bodies every frame, for radius, k-nearest and box queries. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="WorldSettings")
+	bool bBuildSpatialIndex = false;
+
+	/**
+	 *	On the CPU backend, sort bodies in memory along a space-filling curve every this many steps,
+	 *	so bodies close in space stay close in memory. 0 to disable.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="WorldSettings", meta = (ClampMin = 0))
+	int32 BodyReorderInterval = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="WorldSettings", meta = (EditCondition = "BodyReorderInterval > 0"))
+	EBodyReorderCurve BodyReorderCurve = EBodyReorderCurve::Hilbert;
+
+	/**
+	 *	Let each body step with its own power-of-two fraction of the frame time, from its acceleration and jerk,
+	 *	so close encounters are resolved finely while most bodies take big steps. Runs on the CPU backend.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="WorldSettings")
+	bool bIndividualTimesteps = false;
+
+	/** The smallest individual timestep is the frame time divided by 2^MaxTimestepLevel. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="WorldSettings", meta = (EditCondition = "bIndividualTimesteps", ClampMin = 0, ClampMax = 16))
+	int32 MaxTimestepLevel = 6;
+
 	/** The gravitational constant value. Cannot be less than 1.0 to avoid diving by zero. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="WorldSettings", meta = (ClampMin = 1.0f))
 	float GravitationalConstant = 1000.0f;
@@ -73,4 +164,17 @@ public:
 	/** The main camera's aspect ratio. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Rendering")
 	float CameraAspectRatio = 1.777778f;
+
+	/** Whether the simulation steps by FixedDeltaTime rather than by the frame time. */
+	bool UsesFixedDeltaTime() const { return bDeterministic || bEnableReplay; }
+
+	/**
+	 *	Spawn data of the NumberOfBody random bodies followed by the custom ones.
+	 *	With bFromSeed, random bodies draw from RandomSeed so every call gives the same bodies.
+	 */
+	void GenerateBodies(TArray<FBodyData>& OutBodies, bool bFromSeed) const;
+
+private:
+	// Uniformly distributed random point in a circle centered on (0,0), drawn from Stream.
+	static FVector2f RandPointInCircle(const FRandomStream& Stream, float CircleRadius);
 };
@@ -0,0 +1,239 @@
+﻿#include "SimulationConfigWatcher.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "SimulationConfig.h"
+#include "SimulationLogChannels.h"
+#include "UObject/Package.h"
+#include "UObject/UnrealType.h"
+#include "UObject/UObjectGlobals.h"
+
+static TAutoConsoleVariable<float> CVarGravitationalConstant(
+	TEXT("NBodySim.GravitationalConstant"),
+	0.0f,
+	TEXT("Overrides the GravitationalConstant of the running simulation config, 0 to use the config's."));
+
+static TAutoConsoleVariable<float> CVarCameraOrthoWidth(
+	TEXT("NBodySim.CameraOrthoWidth"),
+	0.0f,
+	TEXT("Overrides the CameraOrthoWidth of the running simulation config, 0 to use the config's."));
+
+static TAutoConsoleVariable<FString> CVarConfigFile(
+	TEXT("NBodySim.ConfigFile"),
+	TEXT(""),
+	TEXT("File of Property=Value lines applied onto the running simulation config whenever it is saved, empty to disable."));
+
+/** Seconds between two checks of the watched file's timestamp. */
+static constexpr float ConfigFilePollInterval = 1.0f;
+
+/** Properties the running simulation applies, the others are only read when it starts. */
+static const FName LivePropertyNames[] =
+{
+	GET_MEMBER_NAME_CHECKED(USimulationConfig, GravitationalConstant),
+	GET_MEMBER_NAME_CHECKED(USimulationConfig, CameraOrthoWidth),
+	GET_MEMBER_NAME_CHECKED(USimulationConfig, CameraAspectRatio),
+	GET_MEMBER_NAME_CHECKED(USimulationConfig, NumberOfBody),
+	GET_MEMBER_NAME_CHECKED(USimulationConfig, CustomBodies)
+};
+
+static bool IsLiveProperty(FName Name)
+{
+	for (const FName& LivePropertyName : LivePropertyNames)
+	{
+		if (Name == LivePropertyName)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/** Whether the live property Name of Config can be applied, ClampMin metadata being only available in the editor. */
+static bool IsLivePropertyInRange(const USimulationConfig& Config, FName Name)
+{
+	if (Name == GET_MEMBER_NAME_CHECKED(USimulationConfig, GravitationalConstant))
+	{
+		return Config.GravitationalConstant >= 1.0f;
+	}
+	if (Name == GET_MEMBER_NAME_CHECKED(USimulationConfig, CameraOrthoWidth))
+	{
+		return Config.CameraOrthoWidth > 0.0f;
+	}
+	if (Name == GET_MEMBER_NAME_CHECKED(USimulationConfig, CameraAspectRatio))
+	{
+		return Config.CameraAspectRatio > 0.0f;
+	}
+	if (Name == GET_MEMBER_NAME_CHECKED(USimulationConfig, NumberOfBody))
+	{
+		return Config.NumberOfBody >= 0;
+	}
+	return true;
+}
+
+FSimulationConfigWatcher::FSimulationConfigWatcher(USimulationConfig* InSourceConfig, USimulationConfig* InConfig)
+	: SourceConfig(InSourceConfig)
+	, Config(InConfig)
+{
+	// Overrides are compared to 0 at the first poll, so the ones set before playing apply right away.
+#if WITH_EDITOR
+	PropertyChangedHandle = FCoreUObjectDelegates::OnObjectPropertyChanged.AddRaw(this, &FSimulationConfigWatcher::OnObjectPropertyChanged);
+#endif
+}
+
+FSimulationConfigWatcher::~FSimulationConfigWatcher()
+{
+#if WITH_EDITOR
+	FCoreUObjectDelegates::OnObjectPropertyChanged.Remove(PropertyChangedHandle);
+#endif
+}
+
+bool FSimulationConfigWatcher::ConsumeChanges(float DeltaTime)
+{
+	const float GravitationalConstantOverride = CVarGravitationalConstant.GetValueOnGameThread();
+	const float CameraOrthoWidthOverride = CVarCameraOrthoWidth.GetValueOnGameThread();
+
+	if (GravitationalConstantOverride != LastGravitationalConstantOverride || CameraOrthoWidthOverride != LastCameraOrthoWidthOverride)
+	{
+		LastGravitationalConstantOverride = GravitationalConstantOverride;
+		LastCameraOrthoWidthOverride = CameraOrthoWidthOverride;
+		bChanged = true;
+	}
+
+	TimeSinceFilePoll += DeltaTime;
+	if (TimeSinceFilePoll >= ConfigFilePollInterval)
+	{
+		TimeSinceFilePoll = 0.0f;
+
+		const FString File = CVarConfigFile.GetValueOnGameThread();
+		if (File != WatchedFile)
+		{
+			// A newly watched file is applied right away.
+			WatchedFile = File;
+			WatchedFileTimeStamp = FDateTime::MinValue();
+		}
+
+		if (!WatchedFile.IsEmpty())
+		{
+			const FDateTime TimeStamp = IFileManager::Get().GetTimeStamp(*WatchedFile);
+			if (TimeStamp != FDateTime::MinValue() && TimeStamp != WatchedFileTimeStamp)
+			{
+				WatchedFileTimeStamp = TimeStamp;
+				ApplyConfigFile(WatchedFile);
+			}
+		}
+	}
+
+	const bool bHasChanged = bChanged;
+	bChanged = false;
+	return bHasChanged;
+}
+
+float FSimulationConfigWatcher::GetGravitationalConstant() const
+{
+	return LastGravitationalConstantOverride > 0.0f ? LastGravitationalConstantOverride : Config->GravitationalConstant;
+}
+
+float FSimulationConfigWatcher::GetCameraOrthoWidth() const
+{
+	return LastCameraOrthoWidthOverride > 0.0f ? LastCameraOrthoWidthOverride : Config->CameraOrthoWidth;
+}
+
+void FSimulationConfigWatcher::ApplyConfigFile(const FString& File)
+{
+	USimulationConfig* SimulationConfig = Config.Get();
+	if (!SimulationConfig)
+	{
+		return;
+	}
+
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *File))
+	{
+		UE_LOG(LogNBodySimulation, Warning, TEXT("Failed to read simulation config file '%s'."), *File);
+		return;
+	}
+
+	// Lines are imported onto a scratch copy first, so out of range values never reach the running config.
+	USimulationConfig* ImportedConfig = DuplicateObject<USimulationConfig>(SimulationConfig, GetTransientPackage());
+
+	for (const FString& Line : Lines)
+	{
+		FString Name;
+		FString Value;
+		if (Line.StartsWith(TEXT("#")) || !Line.Split(TEXT("="), &Name, &Value))
+		{
+			continue;
+		}
+
+		Name.TrimStartAndEndInline();
+		Value.TrimStartAndEndInline();
+
+		FProperty* Property = FindFProperty<FProperty>(USimulationConfig::StaticClass(), *Name);
+		if (Property && !IsLiveProperty(Property->GetFName()))
+		{
+			UE_LOG(LogNBodySimulation, Warning, TEXT("Ignoring '%s' in simulation config file '%s' : %s is only read when the simulation starts."), *Line, *File, *Name);
+			continue;
+		}
+
+		if (!Property || !Property->ImportText_Direct(*Value, Property->ContainerPtrToValuePtr<void>(ImportedConfig), ImportedConfig, PPF_None))
+		{
+			UE_LOG(LogNBodySimulation, Warning, TEXT("Ignoring '%s' in simulation config file '%s'."), *Line, *File);
+			continue;
+		}
+	}
+
+	ApplyLiveProperties(*ImportedConfig, FString::Printf(TEXT("simulation config file '%s'"), *File));
+}
+
+void FSimulationConfigWatcher::ApplyLiveProperties(const USimulationConfig& From, const FString& Source)
+{
+	USimulationConfig* SimulationConfig = Config.Get();
+	if (!SimulationConfig)
+	{
+		return;
+	}
+
+	for (const FName& Name : LivePropertyNames)
+	{
+		const FProperty* Property = FindFProperty<FProperty>(USimulationConfig::StaticClass(), Name);
+		check(Property);
+
+		if (Property->Identical_InContainer(&From, SimulationConfig))
+		{
+			continue;
+		}
+
+		if (!IsLivePropertyInRange(From, Name))
+		{
+			FString Value;
+			Property->ExportTextItem_InContainer(Value, &From, nullptr, nullptr, PPF_None);
+			UE_LOG(LogNBodySimulation, Warning, TEXT("Ignoring %s = %s from %s : out of range."), *Name.ToString(), *Value, *Source);
+			continue;
+		}
+
+		Property->CopyCompleteValue_InContainer(SimulationConfig, &From);
+		bChanged = true;
+	}
+}
+
+#if WITH_EDITOR
+void FSimulationConfigWatcher::OnObjectPropertyChanged(UObject* Object, FPropertyChangedEvent& PropertyChangedEvent)
+{
+	const USimulationConfig* EditedConfig = SourceConfig.Get();
+	if (!Object || Object != EditedConfig)
+	{
+		return;
+	}
+
+	// No property name when the whole asset changed, as on undo, so every live property is compared.
+	const FName Name = PropertyChangedEvent.GetMemberPropertyName();
+	if (!Name.IsNone() && !IsLiveProperty(Name))
+	{
+		UE_LOG(LogNBodySimulation, Warning, TEXT("%s is only read when the simulation starts, its change applies from the next run."), *Name.ToString());
+		return;
+	}
+
+	ApplyLiveProperties(*EditedConfig, TEXT("the config asset"));
+}
+#endif
@@ -0,0 +1,57 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+
+class USimulationConfig;
+
+/**
+ *	Watches every source a running simulation config can be changed from :
+ *	- edits of the data asset in the editor,
+ *	- the NBodySim.GravitationalConstant and NBodySim.CameraOrthoWidth console variables, overriding the asset when set,
+ *	- the file named by the NBodySim.ConfigFile console variable, made of Property=Value lines applied onto the config.
+ *
+ *	Only the live properties, GravitationalConstant, CameraOrthoWidth, CameraAspectRatio, NumberOfBody and CustomBodies,
+ *	are copied onto the running config, a transient copy of the asset. Changes of the other properties are logged and skipped.
+ */
+class FSimulationConfigWatcher
+{
+public:
+	FSimulationConfigWatcher(USimulationConfig* InSourceConfig, USimulationConfig* InConfig);
+	~FSimulationConfigWatcher();
+
+	/** Poll the console variables and the watched file. Returns true if any source changed since the last call. */
+	bool ConsumeChanges(float DeltaTime);
+
+	/** Config values after console variable overrides. */
+	float GetGravitationalConstant() const;
+	float GetCameraOrthoWidth() const;
+
+private:
+	/** Import the Property=Value lines of File onto the config. */
+	void ApplyConfigFile(const FString& File);
+
+	/** Copy the live properties of From which differ onto the config, skipping out of range values. */
+	void ApplyLiveProperties(const USimulationConfig& From, const FString& Source);
+
+#if WITH_EDITOR
+	void OnObjectPropertyChanged(UObject* Object, struct FPropertyChangedEvent& PropertyChangedEvent);
+#endif
+
+private:
+	/** Asset edited in the editor, and the running config the simulation reads. */
+	TWeakObjectPtr<USimulationConfig> SourceConfig;
+	TWeakObjectPtr<USimulationConfig> Config;
+
+	bool bChanged = false;
+	FDelegateHandle PropertyChangedHandle;
+
+	/** Console variable values at the last poll. */
+	float LastGravitationalConstantOverride = 0.0f;
+	float LastCameraOrthoWidthOverride = 0.0f;
+
+	/** Watched file and its timestamp at the last poll. */
+	FString WatchedFile;
+	FDateTime WatchedFileTimeStamp;
+	float TimeSinceFilePoll = 0.0f;
+};
@@ -5,6 +5,7 @@
 
 #include "SimulationLogChannels.h"
 #include "Kismet/KismetSystemLibrary.h"
+#include "Misc/StringBuilder.h"
 #include "NBodySimModule.h"
 
 // Sets default values
@@ -31,11 +32,91 @@ void ASimulationEngine::BeginPlay()
 		return;
 	}
 
+	// The simulation reads a transient copy, so values from the config file never end up in the asset.
+	USimulationConfig* SourceConfig = SimulationConfig;
+	SimulationConfig = DuplicateObject<USimulationConfig>(SourceConfig, this);
+
 	// Compute static variables.
 	SimParameters.ViewportWidth = SimulationConfig->CameraOrthoWidth;
 	SimParameters.CameraAspectRatio = SimulationConfig->CameraAspectRatio;
 	
 	InitBodies();
+
+	ConfigWatcher = MakeUnique<FSimulationConfigWatcher>(SourceConfig, SimulationConfig);
+
+	const bool bRequiresCPU = SimulationConfig->bDeterministic || SimulationConfig->bEnableReplay || SimulationConfig->bIndividualTimesteps;
+	if (bRequiresCPU && SimulationConfig->Backend != ESimulationBackend::CPU)
+	{
+		UE_LOG(LogNBodySimulation, Warning, TEXT("Deterministic, replayed and individual timestep simulations are only supported on the CPU backend, switching to it."));
+	}
+
+	if (SimulationConfig->BodyReorderInterval > 0 && SimulationConfig->Backend != ESimulationBackend::CPU && !bRequiresCPU)
+	{
+		UE_LOG(LogNBodySimulation, Warning, TEXT("Body reordering is only supported on the CPU backend, BodyReorderInterval is ignored."));
+	}
+
+	if (SimulationConfig->bEnableReplay && !SimulationConfig->bDeterministic)
+	{
+		UE_LOG(LogNBodySimulation, Warning, TEXT("Replay enabled without deterministic mode, seeking may not reproduce the original run."));
+	}
+
+	if (SimulationConfig->Backend == ESimulationBackend::CPU || bRequiresCPU)
+	{
+		FNBodySimSolverOptions SolverOptions;
+		if (SimulationConfig->bEnableReplay)
+		{
+			if (SimulationConfig->bIndividualTimesteps)
+			{
+				UE_LOG(LogNBodySimulation, Warning, TEXT("Individual timesteps are not time reversible, replay uses a shared timestep."));
+			}
+
+			// Leapfrog allows playing backward without resimulating from a keyframe.
+			SolverOptions.Integrator = ENBodySimIntegrator::Leapfrog;
+		}
+		else if (SimulationConfig->bIndividualTimesteps)
+		{
+			SolverOptions.Integrator = ENBodySimIntegrator::BlockTimesteps;
+			SolverOptions.MaxTimestepLevel = SimulationConfig->MaxTimestepLevel;
+		}
+
+		if (SimulationConfig->UsesFixedDeltaTime())
+		{
+			SimParameters.DeltaTime = SimulationConfig->FixedDeltaTime;
+		}
+
+		if (SimulationConfig->bDeterministic)
+		{
+			SolverOptions.bDeterministic = true;
+			SolverOptions.StateHashInterval = SimulationConfig->StateHashInterval;
+			SolverOptions.OnStateHash = [](uint64 Step, uint32 StateHash)
+			{
+				UE_LOG(LogNBodySimulation, Log, TEXT("Simulation step %llu state hash %08x"), Step, StateHash);
+			};
+		}
+
+		SolverOptions.ReorderInterval = SimulationConfig->BodyReorderInterval;
+		SolverOptions.ReorderCurve = SimulationConfig->BodyReorderCurve == EBodyReorderCurve::Morton ? ENBodySimSpaceFillingCurve::Morton : ENBodySimSpaceFillingCurve::Hilbert;
+		SolverOptions.OnBodiesReordered = [this](TArrayView<const int32> NewToOldSlots)
+		{
+			OnBodiesReordered(NewToOldSlots);
+		};
+
+		CPUSolver = FNBodySimSolver::Create(SimParameters, SolverOptions);
+		if (!CPUSolver)
+		{
+			UE_LOG(LogNBodySimulation, Error, TEXT("Failed to start simulation : could not create the CPU solver."));
+
+			UKismetSystemLibrary::QuitGame(GetWorld(), GetWorld()->GetFirstPlayerController(), EQuitPreference::Quit, false);
+			return;
+		}
+
+		if (SimulationConfig->bEnableReplay)
+		{
+			const SIZE_T MemoryBudget = static_cast<SIZE_T>(SimulationConfig->ReplayMemoryBudgetMB) * 1024 * 1024;
+			Replay = MakeUnique<FNBodySimReplay>(*CPUSolver, SimulationConfig->ReplayKeyframeInterval, MemoryBudget);
+		}
+		return;
+	}
 	
 	FNBodySimModule::Get().BeginRendering();
 	FNBodySimModule::Get().InitWithParameters(SimParameters);
@@ -43,6 +124,9 @@ void ASimulationEngine::BeginPlay()
 
 void ASimulationEngine::BeginDestroy()
 {
+	ConfigWatcher.Reset();
+	Replay.Reset();
+	CPUSolver.Reset();
 	FNBodySimModule::Get().EndRendering();
 	Super::BeginDestroy();
 }
@@ -52,102 +136,365 @@ void ASimulationEngine::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
-	SimParameters.DeltaTime = DeltaTime;
-	FNBodySimModule::Get().UpdateDeltaTime(DeltaTime);
+	// Reproducible runs keep their fixed time step whatever the frame rate.
+	const bool bFixedDeltaTime = CPUSolver && SimulationConfig->UsesFixedDeltaTime();
+	if (!bFixedDeltaTime)
+	{
+		SimParameters.DeltaTime = DeltaTime;
+	}
+
+	if (ConfigWatcher && ConfigWatcher->ConsumeChanges(DeltaTime))
+	{
+		ApplyConfigChanges();
+	}
+
+	if (Replay)
+	{
+		if (ReplayPlaybackSpeed > 0)
+		{
+			Replay->Step(ReplayPlaybackSpeed);
+		}
+		else if (ReplayPlaybackSpeed < 0)
+		{
+			Replay->StepBackward(-ReplayPlaybackSpeed);
+		}
+	}
+	else if (CPUSolver)
+	{
+		if (!bFixedDeltaTime)
+		{
+			CPUSolver->SetDeltaTime(DeltaTime);
+		}
+		CPUSolver->Step();
+	}
+	else
+	{
+		FNBodySimModule::Get().UpdateDeltaTime(DeltaTime);
+	}
 	
 	UpdateBodiesPosition(DeltaTime);
 }
 
 
+bool ASimulationEngine::SeekReplay(int64 Step)
+{
+	if (!Replay || Step < 0)
+	{
+		return false;
+	}
+
+	return Replay->Seek(Step);
+}
+
 void ASimulationEngine::InitBodies()
 {
 	check(InstancedStaticMeshComponent);
 	check(SimulationConfig);
 
-	
-	SimParameters.Bodies.SetNumUninitialized(SimulationConfig->NumberOfBody + SimulationConfig->CustomBodies.Num());
-	BodyTransforms.SetNumUninitialized(SimulationConfig->NumberOfBody + SimulationConfig->CustomBodies.Num());
-	
-	// Initialize the random Bodies with a default random position, velocity and mass depending on config.
-	for (int32 Index = 0; Index < SimulationConfig->NumberOfBody; ++Index)
-	{
-		float RandomMass = FMath::FRandRange(SimulationConfig->InitialBodyMassRange.X, SimulationConfig->InitialBodyMassRange.Y);
-
-		FVector2f RandomPosition(FMath::RandPointInCircle(SimulationConfig->BodySpawnCircleRadius));
+	// Random bodies draw from RandomSeed in deterministic mode, so spawning does not depend on the global RNG state.
+	SimulationConfig->GenerateBodies(SimParameters.Bodies, SimulationConfig->bDeterministic);
+	BodyTransforms.SetNumUninitialized(SimParameters.Bodies.Num());
 
-		/**
-		 *	For the velocity, we need to have a starting velocity for each body so that they are rotating into the circle clockwise.
-		 *	This allow to have a nice starting movement.
-		 *	With 0 starting velocity, we kind of have a Supernova.
-		 *	RadialSpeedRate, once applied, allow to give bodies less velocity when spawning near center (0,0) and more and more near the edge of the spawning circle.
-		 */
-		float RadialSpeedRate = SimulationConfig->BodySpawnCircleRadius / RandomPosition.Size();
-		FVector2f RandomVelocity
-		{
-			FMath::FRandRange(SimulationConfig->BodySpawnVelocityRange.X, SimulationConfig->BodySpawnVelocityRange.Y) / RadialSpeedRate,
-			0
-		};
-		/** Trigonometry to rotate velocity in a clockwise movement in the circle. */
-		RandomVelocity = RandomVelocity.GetRotated(90.0f + FMath::RadiansToDegrees(FMath::Atan2(RandomPosition.Y, RandomPosition.X)));
-		
-		float MeshScale = FMath::Sqrt(RandomMass) * SimulationConfig->MeshScaling;
+	for (int32 Index = 0; Index < SimParameters.Bodies.Num(); ++Index)
+	{
+		const FBodyData& Body = SimParameters.Bodies[Index];
+		float MeshScale = FMath::Sqrt(Body.Mass) * SimulationConfig->MeshScaling;
 		
 		FTransform MeshTransform(
 			FRotator(),
-			FVector(FVector2D(RandomPosition), 0.0f),
+			FVector(FVector2D(Body.Position), 0.0f),
 			FVector(MeshScale, MeshScale, 1.0f)
 		);
 		
 		BodyTransforms[Index] = MeshTransform;
-		SimParameters.Bodies[Index] = FBodyData(RandomMass, RandomPosition, RandomVelocity);
 	}
 
-	// Initialize the additional bodies set in the config file.
-	for (int32 Index = 0; Index < SimulationConfig->CustomBodies.Num(); ++Index)
+	/** Finally add instances to component to spawn them. */
+	InstancedStaticMeshComponent->AddInstances(BodyTransforms, false);
+
+
+	SimParameters.NumBodies = SimParameters.Bodies.Num();
+	SimParameters.GravityConstant = SimulationConfig->GravitationalConstant;
+	NumRandomBodies = SimulationConfig->NumberOfBody;
+	AppliedCustomBodies = SimulationConfig->CustomBodies;
+}
+
+void ASimulationEngine::ApplyConfigChanges()
+{
+	check(ConfigWatcher);
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	const float GravityConstant = ConfigWatcher->GetGravitationalConstant();
+	const float ViewportWidth = ConfigWatcher->GetCameraOrthoWidth();
+	const float CameraAspectRatio = SimulationConfig->CameraAspectRatio;
+	const int32 NumBodies = SimulationConfig->NumberOfBody + SimulationConfig->CustomBodies.Num();
+
+	const bool bConstantsChanged = GravityConstant != SimParameters.GravityConstant
+		|| ViewportWidth != SimParameters.ViewportWidth
+		|| CameraAspectRatio != SimParameters.CameraAspectRatio;
+
+	// Custom entries present before and after are matched by index. A new spawn respawns the body, a new mass only changes its mass.
+	TArray<int32> RespawnedCustomBodies;
+	TArray<int32> ReweightedCustomBodies;
+	const int32 NumKeptCustomBodies = FMath::Min(AppliedCustomBodies.Num(), SimulationConfig->CustomBodies.Num());
+	for (int32 Index = 0; Index < NumKeptCustomBodies; ++Index)
+	{
+		const FBodyConfigEntry& AppliedBody = AppliedCustomBodies[Index];
+		const FBodyConfigEntry& ConfiguredBody = SimulationConfig->CustomBodies[Index];
+
+		if (ConfiguredBody.SpawnPosition != AppliedBody.SpawnPosition || ConfiguredBody.SpawnVelocity != AppliedBody.SpawnVelocity)
+		{
+			RespawnedCustomBodies.Add(Index);
+		}
+		else if (ConfiguredBody.Mass != AppliedBody.Mass)
+		{
+			ReweightedCustomBodies.Add(Index);
+		}
+	}
+
+	const bool bBodiesChanged = NumBodies != SimParameters.Bodies.Num() || SimulationConfig->NumberOfBody != NumRandomBodies || RespawnedCustomBodies.Num() > 0;
+	const bool bMassesChanged = ReweightedCustomBodies.Num() > 0;
+
+	if (!bConstantsChanged && !bBodiesChanged && !bMassesChanged)
 	{
-		FBodyConfigEntry CustomBodyEntry = SimulationConfig->CustomBodies[Index];
-		
-		float MeshScale = FMath::Sqrt(CustomBodyEntry.Mass) * SimulationConfig->MeshScaling;
-		
-		FTransform MeshTransform (
-		FRotator(),
-		FVector(FVector2D(CustomBodyEntry.SpawnPosition), 0.0f),
-		FVector(MeshScale, MeshScale, 1.0f)
-		);
+		return;
+	}
 
-		int32 BodyIndex = SimulationConfig->NumberOfBody + Index;
-		BodyTransforms[BodyIndex] = MeshTransform;
-		SimParameters.Bodies[BodyIndex] = FBodyData(CustomBodyEntry.Mass, CustomBodyEntry.SpawnPosition, CustomBodyEntry.SpawnVelocity);
+	if (Replay)
+	{
+		UE_LOG(LogNBodySimulation, Warning, TEXT("Ignoring config changes while recording a replay, the recorded run must stay reproducible."));
+		return;
 	}
 
-	/** Finally add instances to component to spawn them. */
-	InstancedStaticMeshComponent->AddInstances(BodyTransforms, false);
+	if (ViewportWidth <= 0.0f || CameraAspectRatio <= 0.0f)
+	{
+		UE_LOG(LogNBodySimulation, Warning, TEXT("Ignoring config changes : invalid viewport (width %f, aspect ratio %f)."), ViewportWidth, CameraAspectRatio);
+		return;
+	}
+
+	TStringBuilder<256> Changes;
+
+	if (bConstantsChanged)
+	{
+		Changes.Appendf(TEXT(" GravityConstant %g -> %g, ViewportWidth %g -> %g, CameraAspectRatio %g -> %g."),
+			SimParameters.GravityConstant, GravityConstant, SimParameters.ViewportWidth, ViewportWidth, SimParameters.CameraAspectRatio, CameraAspectRatio);
+
+		SimParameters.GravityConstant = GravityConstant;
+		SimParameters.ViewportWidth = ViewportWidth;
+		SimParameters.CameraAspectRatio = CameraAspectRatio;
+
+		// Only the constants are pushed, bodies buffers stay as they are.
+		if (CPUSolver)
+		{
+			CPUSolver->SetGravityConstant(GravityConstant);
+			CPUSolver->SetViewport(ViewportWidth, CameraAspectRatio);
+		}
+		else
+		{
+			FNBodySimModule::Get().UpdateConstants(GravityConstant, CameraAspectRatio, ViewportWidth);
+		}
+	}
+
+	for (int32 Index : ReweightedCustomBodies)
+	{
+		Changes.Appendf(TEXT(" Custom body %d mass %g -> %g."), Index, AppliedCustomBodies[Index].Mass, SimulationConfig->CustomBodies[Index].Mass);
+	}
+
+	for (int32 Index : RespawnedCustomBodies)
+	{
+		const FBodyConfigEntry& ConfiguredBody = SimulationConfig->CustomBodies[Index];
+		Changes.Appendf(TEXT(" Custom body %d respawned at (%g, %g) with velocity (%g, %g) and mass %g."),
+			Index, ConfiguredBody.SpawnPosition.X, ConfiguredBody.SpawnPosition.Y, ConfiguredBody.SpawnVelocity.X, ConfiguredBody.SpawnVelocity.Y, ConfiguredBody.Mass);
+	}
+
+	if (bBodiesChanged)
+	{
+		// New masses of the kept custom bodies come along with the resize.
+		Changes.Appendf(TEXT(" Bodies %d -> %d (%d custom)."), SimParameters.Bodies.Num(), NumBodies, SimulationConfig->CustomBodies.Num());
+		ResizeBodies(RespawnedCustomBodies);
+	}
+	else if (bMassesChanged)
+	{
+		UpdateCustomBodyMasses(ReweightedCustomBodies);
+	}
 
+	AppliedCustomBodies = SimulationConfig->CustomBodies;
 
+	// With the GPU backend, the render thread logs its own share once it reallocated the buffers.
+	UE_LOG(LogNBodySimulation, Log, TEXT("Applied config changes on the game thread in %.3f ms :%s"), (FPlatformTime::Seconds() - StartTime) * 1000.0, Changes.ToString());
+}
+
+void ASimulationEngine::ResizeBodies(TArrayView<const int32> RespawnedCustomBodies)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_SimulationEngine_ResizeBodies);
+
+	TArray<FBodyData> Bodies;
+	SimulationConfig->GenerateBodies(Bodies, SimulationConfig->bDeterministic);
+
+	/**
+	 *	Random and custom bodies are matched separately : a body keeps its state as long as its index within
+	 *	its group still exists, and new or respawned ones spawn as configured. Random bodies keep their drawn
+	 *	mass, custom ones take their configured mass.
+	 */
+	const int32 NumCustomBodies = SimParameters.Bodies.Num() - NumRandomBodies;
+	TArray<int32> NewToOldBodies;
+	NewToOldBodies.SetNumUninitialized(Bodies.Num());
+
+	for (int32 Index = 0; Index < Bodies.Num(); ++Index)
+	{
+		const bool bRandomBody = Index < SimulationConfig->NumberOfBody;
+		const int32 GroupIndex = bRandomBody ? Index : Index - SimulationConfig->NumberOfBody;
+		const int32 OldGroupSize = bRandomBody ? NumRandomBodies : NumCustomBodies;
+		const bool bRespawned = !bRandomBody && RespawnedCustomBodies.Contains(GroupIndex);
+		const int32 OldIndex = GroupIndex < OldGroupSize && !bRespawned ? (bRandomBody ? GroupIndex : NumRandomBodies + GroupIndex) : INDEX_NONE;
+
+		NewToOldBodies[Index] = OldIndex;
+		if (bRandomBody && OldIndex != INDEX_NONE)
+		{
+			Bodies[Index].Mass = SimParameters.Bodies[OldIndex].Mass;
+		}
+	}
+
+	// Buffers are reallocated here only, when the body count changes.
+	if (CPUSolver)
+	{
+		CPUSolver->ResizeBodies(Bodies, NewToOldBodies);
+	}
+	else
+	{
+		FNBodySimModule::Get().ResizeBodies(Bodies, NewToOldBodies);
+	}
+
+	SimParameters.Bodies = MoveTemp(Bodies);
 	SimParameters.NumBodies = SimParameters.Bodies.Num();
-	SimParameters.GravityConstant = SimulationConfig->GravitationalConstant;
+	NumRandomBodies = SimulationConfig->NumberOfBody;
+
+	// Rebuild the mesh instances, placed at their simulated position by the next update.
+	BodyTransforms.SetNum(SimParameters.Bodies.Num());
+	for (int32 Index = 0; Index < SimParameters.Bodies.Num(); ++Index)
+	{
+		const FBodyData& Body = SimParameters.Bodies[Index];
+		const float MeshScale = FMath::Sqrt(Body.Mass) * SimulationConfig->MeshScaling;
+
+		BodyTransforms[Index] = FTransform(FRotator(), FVector(FVector2D(Body.Position), 0.0f), FVector(MeshScale, MeshScale, 1.0f));
+	}
+
+	InstancedStaticMeshComponent->ClearInstances();
+	InstancedStaticMeshComponent->AddInstances(BodyTransforms, false);
+}
+
+void ASimulationEngine::UpdateCustomBodyMasses(TArrayView<const int32> CustomBodies)
+{
+	for (int32 Index : CustomBodies)
+	{
+		const int32 BodyId = NumRandomBodies + Index;
+		const float Mass = SimulationConfig->CustomBodies[Index].Mass;
+		SimParameters.Bodies[BodyId].Mass = Mass;
+
+		if (CPUSolver)
+		{
+			CPUSolver->SetBodyMass(BodyId, Mass);
+		}
+
+		// Mesh instances follow the solver's memory order, the new scale is sent with the next positions.
+		const int32 Slot = CPUSolver ? CPUSolver->GetBodySlot(BodyId) : BodyId;
+		const float MeshScale = FMath::Sqrt(Mass) * SimulationConfig->MeshScaling;
+		BodyTransforms[Slot].SetScale3D(FVector(MeshScale, MeshScale, 1.0f));
+	}
+
+	if (!CPUSolver)
+	{
+		TArray<float> Masses;
+		Masses.SetNumUninitialized(SimParameters.Bodies.Num());
+		for (int32 Index = 0; Index < SimParameters.Bodies.Num(); ++Index)
+		{
+			Masses[Index] = SimParameters.Bodies[Index].Mass;
+		}
+		FNBodySimModule::Get().UpdateMasses(Masses);
+	}
 }
 
 void ASimulationEngine::UpdateBodiesPosition(float DeltaTime)
 {
+	if (CPUSolver)
+	{
+		UpdateBodiesTransforms(CPUSolver->GetPositions());
+		UpdateSpatialIndex(CPUSolver->GetPositions(), CPUSolver->GetBodyIds());
+		return;
+	}
+
 	// Retrieve GPU computed bodies position.
 	TArray<FVector2f> GPUOutputPositions = FNBodySimModule::Get().GetComputedPositions();
 
 	if (GPUOutputPositions.Num() != SimParameters.Bodies.Num())
 	{
+		// Positions of the previous body count until the render thread reallocated the buffers, expected for a frame or two.
+		if (FNBodySimModule::Get().IsResizePending())
+		{
+			return;
+		}
+
 		UE_LOG(LogTemp, Warning, TEXT("Size differ for GPU Velocities Ouput buffer and current Bodies instanced mesh buffer. Bodies (%d) Output(%d)"), SimParameters.Bodies.Num(), GPUOutputPositions.Num());
 		return;
 	}
-	
+
+	UpdateBodiesTransforms(GPUOutputPositions);
+	UpdateSpatialIndex(GPUOutputPositions);
+}
+
+void ASimulationEngine::UpdateBodiesTransforms(TArrayView<const FVector2f> Positions)
+{
 	QUICK_SCOPE_CYCLE_COUNTER(STAT_SimulationEngine_UpdateBodiesPosition);
 
 	// Update bodies visual with new positions.
-	for (int i = 0; i < SimParameters.Bodies.Num(); i++)
+	for (int i = 0; i < Positions.Num(); i++)
 	{
-		BodyTransforms[i].SetTranslation(FVector(FVector2D(GPUOutputPositions[i]), 0.0f));
+		BodyTransforms[i].SetTranslation(FVector(FVector2D(Positions[i]), 0.0f));
 	}
 	InstancedStaticMeshComponent->BatchUpdateInstancesTransforms(0, BodyTransforms, false, true);
 }
 
+void ASimulationEngine::OnBodiesReordered(TArrayView<const int32> NewToOldSlots)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_SimulationEngine_OnBodiesReordered);
+
+	ReorderedBodyTransforms.SetNumUninitialized(BodyTransforms.Num(), false);
+	for (int32 Slot = 0; Slot < NewToOldSlots.Num(); ++Slot)
+	{
+		ReorderedBodyTransforms[Slot] = BodyTransforms[NewToOldSlots[Slot]];
+	}
+	Swap(BodyTransforms, ReorderedBodyTransforms);
+}
+
+void ASimulationEngine::UpdateSpatialIndex(TArrayView<const FVector2f> Positions, TArrayView<const int32> BodyIds)
+{
+	if (!SimulationConfig->bBuildSpatialIndex)
+	{
+		return;
+	}
+
+	// Bodies wrap along screen bounds, so the screen is the whole simulated area.
+	const FVector2f HalfScreen(SimParameters.ViewportWidth / 2.0f, SimParameters.ViewportWidth / SimParameters.CameraAspectRatio / 2.0f);
+	SpatialIndex.Update(Positions, FBox2f(-HalfScreen, HalfScreen), BodyIds);
+}
 
+TArray<int32> ASimulationEngine::FindBodiesInRadius(FVector2D Center, float Radius) const
+{
+	TArray<int32> Bodies;
+	if (FNBodySimSpatialSnapshotPtr Snapshot = SpatialIndex.GetSnapshot())
+	{
+		Snapshot->QueryRadius(FVector2f(Center), Radius, Bodies);
+	}
+	return Bodies;
+}
 
+TArray<int32> ASimulationEngine::FindNearestBodies(FVector2D Center, int32 K) const
+{
+	TArray<int32> Bodies;
+	if (FNBodySimSpatialSnapshotPtr Snapshot = SpatialIndex.GetSnapshot())
+	{
+		Snapshot->QueryKNearest(FVector2f(Center), K, Bodies);
+	}
+	return Bodies;
+}
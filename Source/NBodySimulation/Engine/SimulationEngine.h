@@ -4,9 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "NBodySimModule.h"
+#include "NBodySimReplay.h"
+#include "NBodySimSolver.h"
+#include "NBodySimSpatialIndex.h"
 #include "GameFramework/Actor.h"
 #include "NBodySimTypesDefinitions.h"
 #include "Config/SimulationConfig.h"
+#include "Config/SimulationConfigWatcher.h"
 #include "Components/InstancedStaticMeshComponent.h"
 #include "SimulationEngine.generated.h"
 
@@ -23,12 +27,52 @@ public:
 	virtual void BeginDestroy() override;
 	virtual void Tick(float DeltaTime) override;
 
+	/** Move the replayed simulation to the given step. Returns false if no replay is recorded or the step is too old. */
+	UFUNCTION(BlueprintCallable, Category="Replay")
+	bool SeekReplay(int64 Step);
+
+	/** Steps simulated per frame while replaying, negative to play backward and 0 to pause. */
+	UFUNCTION(BlueprintCallable, Category="Replay")
+	void SetReplayPlaybackSpeed(int32 StepsPerFrame) { ReplayPlaybackSpeed = StepsPerFrame; }
+
+	UFUNCTION(BlueprintPure, Category="Replay")
+	int64 GetReplayCurrentStep() const { return Replay ? Replay->GetCurrentStep() : 0; }
+
+	/** Index of the bodies, to query from any thread. Only updated when enabled in the config. */
+	const FNBodySimSpatialIndex& GetSpatialIndex() const { return SpatialIndex; }
+
+	/** Stable ids of the bodies at most Radius away from Center, valid whatever their memory order. Requires bBuildSpatialIndex in the config. */
+	UFUNCTION(BlueprintCallable, Category="Simulation")
+	TArray<int32> FindBodiesInRadius(FVector2D Center, float Radius) const;
+
+	/** Ids of the K bodies nearest to Center, nearest first. Requires bBuildSpatialIndex in the config. */
+	UFUNCTION(BlueprintCallable, Category="Simulation")
+	TArray<int32> FindNearestBodies(FVector2D Center, int32 K) const;
+
 protected:
 	virtual void InitBodies();
 
 	// Update Bodies position on CPU.
 	virtual void UpdateBodiesPosition(float DeltaTime);
 
+	// Update bodies visual from the given computed positions.
+	void UpdateBodiesTransforms(TArrayView<const FVector2f> Positions);
+
+	// Keep the mesh instances in the same memory order as the solver's bodies.
+	void OnBodiesReordered(TArrayView<const int32> NewToOldSlots);
+
+	// Rebuild the spatial index from the given computed positions and their body ids, if enabled.
+	void UpdateSpatialIndex(TArrayView<const FVector2f> Positions, TArrayView<const int32> BodyIds = TArrayView<const int32>());
+
+	// Diff the config against the running simulation and push the differences to the solver or the compute shader.
+	void ApplyConfigChanges();
+
+	// Change the bodies of the running simulation. Remaining bodies keep their state, except the custom ones in RespawnedCustomBodies.
+	void ResizeBodies(TArrayView<const int32> RespawnedCustomBodies);
+
+	// Push the configured mass of the given custom bodies to the running simulation, without reallocating its buffers.
+	void UpdateCustomBodyMasses(TArrayView<const int32> CustomBodies);
+
 	
 public:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category="Simulation")
@@ -43,8 +87,31 @@ private:
 
 	/** Store all the bodies data of the simulation. */
 	FNBodySimParameters SimParameters;
+
+	/** Headless solver advancing the simulation when running on the CPU backend, null on GPU. */
+	TUniquePtr<FNBodySimSolver> CPUSolver;
+
+	/** Keyframes of the CPU solver when replay is enabled. */
+	TUniquePtr<FNBodySimReplay> Replay;
+
+	int32 ReplayPlaybackSpeed = 1;
+
+	/** Spatial index of the bodies, rebuilt incrementally after each step. */
+	FNBodySimSpatialIndex SpatialIndex;
+
+	/** Watches the config sources while playing, to hot-reload their changes. */
+	TUniquePtr<FSimulationConfigWatcher> ConfigWatcher;
+
+	/** Number of random bodies in SimParameters, the custom ones follow them. */
+	int32 NumRandomBodies = 0;
+
+	/** Custom bodies of the config as last applied, to find the edited entries. */
+	TArray<FBodyConfigEntry> AppliedCustomBodies;
 	
 	/** Store the transform of all body of the simulation. */
 	UPROPERTY()
 	TArray<FTransform> BodyTransforms;
+
+	/** Scratch buffer to reorder BodyTransforms. */
+	TArray<FTransform> ReorderedBodyTransforms;
 };
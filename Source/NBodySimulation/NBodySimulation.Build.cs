@@ -21,7 +21,7 @@ public class NBodySimulation : ModuleRules
 		
 		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore" });
 
-		PrivateDependencyModuleNames.AddRange(new string[] { "NBodySim", "RHI" });
+		PrivateDependencyModuleNames.AddRange(new string[] { "NBodySim", "NBodySimCore", "NBodySimDistributed", "RHI" });
 
 		// Uncomment if you are using Slate UI
 		// PrivateDependencyModuleNames.AddRange(new string[] { "Slate", "SlateCore" });
@@ -0,0 +1,104 @@
+﻿#include "Misc/AutomationTest.h"
+#include "Misc/Crc.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "NBodySimSolver.h"
+#include "Config/SimulationConfig.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace SimulationDeterminismTests
+{
+	static constexpr uint32 TestFlags = EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter;
+
+	static uint32 HashBodies(const TArray<FBodyData>& Bodies)
+	{
+		return FCrc::MemCrc32(Bodies.GetData(), Bodies.Num() * sizeof(FBodyData));
+	}
+
+	/** Spawn and run Config the way the simulation engine does in deterministic mode, and return the final state hash. */
+	static uint32 RunDeterministic(const USimulationConfig& Config, int32 NumSteps, EParallelForFlags ParallelForFlags)
+	{
+		FNBodySimParameters Parameters;
+		Config.GenerateBodies(Parameters.Bodies, true);
+		Parameters.NumBodies = Parameters.Bodies.Num();
+		Parameters.GravityConstant = Config.GravitationalConstant;
+		Parameters.ViewportWidth = Config.CameraOrthoWidth;
+		Parameters.CameraAspectRatio = Config.CameraAspectRatio;
+		Parameters.DeltaTime = Config.FixedDeltaTime;
+
+		FNBodySimSolverOptions Options;
+		Options.bDeterministic = true;
+		Options.ParallelForFlags = ParallelForFlags;
+		Options.ReorderInterval = Config.BodyReorderInterval;
+
+		TUniquePtr<FNBodySimSolver> Solver = FNBodySimSolver::Create(Parameters, Options);
+		check(Solver);
+
+		Solver->Step(NumSteps);
+		return Solver->ComputeStateHash();
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSimulationDeterministicRunTest, "NBodySim.Simulation.DeterministicRun", SimulationDeterminismTests::TestFlags)
+
+bool FSimulationDeterministicRunTest::RunTest(const FString& Parameters)
+{
+	using namespace SimulationDeterminismTests;
+
+	USimulationConfig* Config = NewObject<USimulationConfig>();
+	Config->NumberOfBody = 600;
+	Config->RandomSeed = 7;
+	Config->bDeterministic = true;
+	Config->BodyReorderInterval = 10;
+
+	FBodyConfigEntry& CustomBody = Config->CustomBodies.AddDefaulted_GetRef();
+	CustomBody.Mass = 5000.0f;
+	CustomBody.SpawnPosition = FVector2f(300.0f, -200.0f);
+	CustomBody.SpawnVelocity = FVector2f(0.0f, 50.0f);
+
+	// Seeded spawns are the same on every call, unseeded ones follow the global random stream.
+	TArray<FBodyData> Bodies;
+	TArray<FBodyData> OtherBodies;
+	Config->GenerateBodies(Bodies, true);
+	Config->GenerateBodies(OtherBodies, true);
+	TestEqual(TEXT("Seeded spawns are identical"), HashBodies(OtherBodies), HashBodies(Bodies));
+
+	Config->GenerateBodies(OtherBodies, false);
+	TestNotEqual(TEXT("Unseeded spawns differ"), HashBodies(OtherBodies), HashBodies(Bodies));
+
+	Config->RandomSeed = 8;
+	Config->GenerateBodies(OtherBodies, true);
+	TestNotEqual(TEXT("Another seed spawns other bodies"), HashBodies(OtherBodies), HashBodies(Bodies));
+	Config->RandomSeed = 7;
+
+	// Same final state whatever the scheduling.
+	const int32 NumSteps = 120;
+	const uint32 StateHash = RunDeterministic(*Config, NumSteps, EParallelForFlags::ForceSingleThread);
+	TestEqual(TEXT("State hash with every worker"), RunDeterministic(*Config, NumSteps, EParallelForFlags::None), StateHash);
+	TestEqual(TEXT("State hash with unbalanced scheduling"), RunDeterministic(*Config, NumSteps, EParallelForFlags::Unbalanced), StateHash);
+
+	/**
+	 *	And the same as the golden hash recorded by a previous run of this build configuration, so a change of the
+	 *	spawn, the solver or the compiler settings that alters results is caught. Delete the file to record a new one.
+	 */
+	const FString GoldenFile = FPaths::Combine(FPaths::AutomationDir(), TEXT("NBodySim"), TEXT("DeterministicRunHash.txt"));
+	const FString Hash = FString::Printf(TEXT("%08x"), StateHash);
+
+	FString GoldenHash;
+	if (FFileHelper::LoadFileToString(GoldenHash, *GoldenFile))
+	{
+		TestEqual(FString::Printf(TEXT("State hash against %s"), *GoldenFile), Hash, GoldenHash.TrimStartAndEnd());
+	}
+	else if (FFileHelper::SaveStringToFile(Hash, *GoldenFile))
+	{
+		AddWarning(FString::Printf(TEXT("No golden state hash yet, recorded %s in %s."), *Hash, *GoldenFile));
+	}
+	else
+	{
+		AddError(FString::Printf(TEXT("Failed to record the golden state hash in %s."), *GoldenFile));
+	}
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS